@@ -0,0 +1,42 @@
+# Measures the cost of adding children to a folder and looking up their rows, and the calls FileSystemModel::index()
+# and FileSystemModel::parent() make, for folders of up to 100k children.
+# It's a standalone console program built by YappariExplorer.pro with CONFIG+=benchmarks, run it from a release build.
+
+QT       += core gui concurrent
+
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+DEFINES += ICU_COLLATOR
+
+CONFIG(release, debug|release) {
+    DEFINES += QT_NO_DEBUG_OUTPUT
+    QMAKE_CXXFLAGS_RELEASE += -O3 -march=native
+}
+
+INCLUDEPATH += ../..
+
+SOURCES += \
+    ../../Shell/Collation.cpp \
+    ../../Shell/FileSystemItem.cpp \
+    ../../Shell/FileSystemItemArena.cpp \
+    ../../Shell/FileTypeCache.cpp \
+    ../../Shell/NameIndex.cpp \
+    main.cpp
+
+HEADERS += \
+    ../../Shell/Collation.h \
+    ../../Shell/FileSystemItem.h \
+    ../../Shell/FileSystemItemArena.h \
+    ../../Shell/FileTypeCache.h \
+    ../../Shell/NameIndex.h
+
+unix {
+    LIBS += -licui18n -licuuc
+}
+
+win32 {
+    INCLUDEPATH += ../../ThirdParty/Win/icu4c-68/include
+    LIBS += -L$$PWD/../../ThirdParty/Win/icu4c-68/bin -licuin68 -licuuc68
+}
@@ -0,0 +1,165 @@
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QVector>
+
+#include "Shell/FileSystemItem.h"
+
+// Every folder size is measured this many times and the fastest run is kept
+#define BENCHMARK_RUNS          5
+
+// The cost per child of the largest folder can be at most this many times the one of the smallest
+#define LINEARITY_FACTOR        4.0
+
+// Children removed one by one from the start of every folder, like refreshFolder() does with the ones that are gone
+#define REMOVED_CHILDREN        100
+
+namespace {
+
+struct Result {
+    double addNSecs     { -1 };     // Per child
+    double rowNSecs     { -1 };     // Per child
+    double indexNSecs   { -1 };     // Per child
+    double parentNSecs  { -1 };     // Per child
+    double removeNSecs  { -1 };     // Per removed child
+};
+
+FileSystemItem::NativeString nativeName(int n)
+{
+#ifdef Q_OS_WIN
+    return QString("file%1.txt").arg(n);
+#else
+    return QByteArray("file") + QByteArray::number(n) + QByteArray(".txt");
+#endif
+}
+
+QString childPath(FileSystemItem *folder, int n)
+{
+#ifdef Q_OS_WIN
+    return folder->getPath() + '\\' + nativeName(n);
+#else
+    return folder->getPath() + '/' + QString::fromUtf8(nativeName(n));
+#endif
+}
+
+double best(double current, double value)
+{
+    return (current < 0 || value < current) ? value : current;
+}
+
+/*!
+ * \brief Measures a folder of \a count children, and returns false if any row is wrong.
+ */
+bool measure(int count, Result &result)
+{
+    // The folder is the last of as many siblings as children it has, so looking up its row costs as much as theirs
+    FileSystemItem *top = new FileSystemItem(QCoreApplication::applicationDirPath());
+    for (int i = 0; i < count - 1; i++)
+        top->addChild(new FileSystemItem(top, nativeName(i)));
+
+    FileSystemItem *folder = new FileSystemItem(top, nativeName(count));
+    top->addChild(folder);
+
+    QVector<FileSystemItem *> children;
+    children.reserve(count);
+    for (int i = 0; i < count; i++)
+        children.append(new FileSystemItem(folder, nativeName(i)));
+
+    QElapsedTimer timer;
+
+    // What a listing does
+    timer.start();
+    for (FileSystemItem *child : qAsConst(children))
+        folder->addChild(child);
+    result.addNSecs = best(result.addNSecs, double(timer.nsecsElapsed()) / count);
+
+    // What updating every child of the folder does, through FileSystemModel::index(FileSystemItem *)
+    timer.start();
+    qint64 sum = 0;
+    for (FileSystemItem *child : qAsConst(children))
+        sum += folder->childRow(child);
+    result.rowNSecs = best(result.rowNSecs, double(timer.nsecsElapsed()) / count);
+
+    bool correct = (sum == qint64(count) * (count - 1) / 2);
+    for (int i = 0; i < count && correct; i++)
+        correct = (folder->childRow(children.at(i)) == i);
+
+    // What FileSystemModel::index(int, int, const QModelIndex &) does for every row
+    timer.start();
+    int found = 0;
+    for (int i = 0; i < count; i++)
+        found += (folder->getChildAt(i) == children.at(i));
+    result.indexNSecs = best(result.indexNSecs, double(timer.nsecsElapsed()) / count);
+
+    correct = correct && (found == count);
+
+    // What FileSystemModel::parent() does for every index of the folder
+    timer.start();
+    qint64 parentRows = 0;
+    for (FileSystemItem *child : qAsConst(children)) {
+        FileSystemItem *parent = child->getParent();
+        FileSystemItem *grandParent = parent->getParent();
+        parentRows += (grandParent != nullptr) ? grandParent->childRow(parent) : 0;
+    }
+    result.parentNSecs = best(result.parentNSecs, double(timer.nsecsElapsed()) / count);
+
+    correct = correct && (parentRows == qint64(count) * (count - 1));
+
+    // Every removal renumbers the children after it
+    int removed = qMin(REMOVED_CHILDREN, count);
+    timer.start();
+    for (int i = 0; i < removed; i++)
+        folder->removeChild(childPath(folder, i));
+    result.removeNSecs = best(result.removeNSecs, double(timer.nsecsElapsed()) / removed);
+
+    for (int i = 0; i < removed; i++)
+        delete children.at(i);
+
+    for (int i = removed; i < count && correct; i++)
+        correct = (folder->childRow(children.at(i)) == i - removed);
+
+    delete top;
+
+    return correct;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+
+    const QVector<int> sizes { 12500, 25000, 50000, 100000 };
+    QVector<Result> results(sizes.size());
+
+    for (int run = 0; run < BENCHMARK_RUNS; run++) {
+        for (int i = 0; i < sizes.size(); i++) {
+            if (!measure(sizes.at(i), results[i])) {
+                out << "Wrong rows with " << sizes.at(i) << " children\n";
+                return 1;
+            }
+        }
+    }
+
+    out << "children    add ns/child    childRow ns/child    index ns/child    parent ns/child    removeChild ns/removal\n";
+    for (int i = 0; i < sizes.size(); i++) {
+        out << qSetFieldWidth(8) << sizes.at(i) << qSetFieldWidth(16) << results.at(i).addNSecs
+            << qSetFieldWidth(21) << results.at(i).rowNSecs << qSetFieldWidth(18) << results.at(i).indexNSecs
+            << qSetFieldWidth(19) << results.at(i).parentNSecs << qSetFieldWidth(26) << results.at(i).removeNSecs
+            << qSetFieldWidth(0) << '\n';
+    }
+
+    // Adding the children and finding all their rows and parents must take linear time, so the cost per child stays
+    // flat
+    const Result &smallest = results.first();
+    const Result &largest = results.last();
+    bool linear = largest.addNSecs <= smallest.addNSecs * LINEARITY_FACTOR &&
+                  largest.rowNSecs <= smallest.rowNSecs * LINEARITY_FACTOR &&
+                  largest.indexNSecs <= smallest.indexNSecs * LINEARITY_FACTOR &&
+                  largest.parentNSecs <= smallest.parentNSecs * LINEARITY_FACTOR;
+
+    out << (linear ? "Linear" : "Not linear") << '\n';
+
+    return linear ? 0 : 1;
+}
@@ -32,17 +32,27 @@
 #include <QFileIconProvider>
 #include <QtConcurrent/QtConcurrentRun>
 #include <QTimer>
+#include <QFileInfo>
 #include <QMimeData>
 #include <QBrush>
 #include <QDebug>
+#include <QEvent>
 #include <QDir>
 #include <QUrl>
+#include <QSet>
 
 #include <limits>
 #include <cmath>
 
 #include "once.h"
 #include "FileSystemModel.h"
+#include "Shell/Collation.h"
+
+// Maximum number of children kept in folders that were fetched ahead of time and not used yet
+#define PREFETCH_BUDGET         20000
+
+// Files added by the watcher within this many milliseconds are inserted together
+#define PENDING_PATHS_DELAY     20
 
 #ifdef Q_OS_WIN
 #   include "Shell/Win/WinFileInfoRetriever.h"
@@ -90,8 +100,12 @@ FileSystemModel::FileSystemModel(QObject *parent, bool hasWatcher) : QAbstractIt
     // It's because of the "roles" argument of the signal. The fingerprint of the method is as follows:
     // dataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight, const QVector<int> &roles)
     qRegisterMetaType<QVector<int>>("QVector<int>");
+    qRegisterMetaType<QList<FileSystemItem *>>("QList<FileSystemItem *>");
+    qRegisterMetaType<QVector<FileInfoRetriever::Metadata>>("QVector<FileInfoRetriever::Metadata>");
 
+    // Children are delivered in batches while a folder is being read
     fileInfoRetriever = new PlatformInfoRetriever();
+    fileInfoRetriever->setStreaming(true);
     shellActions = new PlatformShellActions();
 
     // Get the default icons
@@ -102,6 +116,10 @@ FileSystemModel::FileSystemModel(QObject *parent, bool hasWatcher) : QAbstractIt
 
     connect(fileInfoRetriever, &FileInfoRetriever::parentInfoUpdated, this, &FileSystemModel::parentInfoUpdated);
     connect(fileInfoRetriever, &FileInfoRetriever::parentChildrenUpdated, this, &FileSystemModel::parentChildrenUpdated);
+    connect(fileInfoRetriever, &FileInfoRetriever::parentChildrenAdded, this, &FileSystemModel::parentChildrenAdded);
+    connect(fileInfoRetriever, &FileInfoRetriever::parentMetadataUpdated, this, &FileSystemModel::parentMetadataUpdated);
+    connect(fileInfoRetriever, &FileInfoRetriever::childrenMetadataUpdated, this, &FileSystemModel::childrenMetadataUpdated);
+    connect(fileInfoRetriever, &FileInfoRetriever::subFoldersUpdated, this, &FileSystemModel::subFoldersUpdated);
     connect(fileInfoRetriever, &FileInfoRetriever::itemUpdated, this, &FileSystemModel::itemUpdated);
     connect(fileInfoRetriever, &FileInfoRetriever::iconUpdated, this, &FileSystemModel::iconUpdated);
 
@@ -117,10 +135,31 @@ FileSystemModel::FileSystemModel(QObject *parent, bool hasWatcher) : QAbstractIt
 
     fileInfoRetriever->start();
 
+    pendingPathsTimer = new QTimer(this);
+    pendingPathsTimer->setSingleShot(true);
+    pendingPathsTimer->setInterval(PENDING_PATHS_DELAY);
+    connect(pendingPathsTimer, &QTimer::timeout, this, &FileSystemModel::insertPendingPaths);
+
     // Garbage collector
     QTimer *timer = new QTimer(this);
     connect(timer, &QTimer::timeout, this, &FileSystemModel::garbageCollector);
     timer->start(300'000);
+
+    // Only this model watches for locale changes, the sort models follow it \sa collationChanged
+    qApp->installEventFilter(this);
+}
+
+/*!
+ * \brief Makes the collation follow the new locale when it changes, and tells the sort models to sort again.
+ */
+bool FileSystemModel::eventFilter(QObject *watched, QEvent *event)
+{
+    if (watched == qApp && event->type() == QEvent::LocaleChange) {
+        Collation::localeChanged();
+        emit collationChanged();
+    }
+
+    return QAbstractItemModel::eventFilter(watched, event);
 }
 
 /*!
@@ -145,6 +184,9 @@ FileSystemModel::~FileSystemModel()
     if (fileInfoRetriever != nullptr)
         delete fileInfoRetriever;
 
+    for (PendingPaths &pending : pendingPaths)
+        qDeleteAll(pending.items);
+
     if (root != nullptr)
         delete root;
 
@@ -212,6 +254,8 @@ QModelIndex FileSystemModel::parent(const QModelIndex &index) const
  *
  * If the scope of the model is a List, the parent is ignored. It will always return the
  * number of elements of the list.
+ *
+ * While a parent is being fetched this is the number of children inserted so far.
  */
 int FileSystemModel::rowCount(const QModelIndex &parent) const
 {
@@ -220,12 +264,9 @@ int FileSystemModel::rowCount(const QModelIndex &parent) const
 
     if (parent.isValid() && parent.internalPointer() != nullptr) {
 
+        // Children are only added to an item in this thread (see parentChildrenAdded), so it's safe to count
+        // them even if the item is currently being fetched
         FileSystemItem *item = getFileSystemItem(parent);
-
-        // If the item is currently being fetched return 0 until it's done
-        if (item->getLock())
-            return 0;
-
         return item->childrenCount();
     }
 
@@ -267,6 +308,9 @@ int FileSystemModel::columnCount(const QModelIndex &parent) const
  * This way we will only request icons from the filesystem for indexes that are actually visible in the viewport.
  * We get better performance in very long file listings like C:\Windows\System32.
  *
+ * If the role is Qt::DisplayRole and the metadata of the item is still pending, the Size, Type and LastChangeTime columns
+ * will request it before anything else in the queue.  Only visible items are painted, so they are the first ones to get it.
+ *
  * If the role is Qt::DisplayRole, this function will customize the output for the Size column. The LastChangeSince column
  * is millisecs since epoch, so the model can sort by it easily.  A delegate for the LastChangeSince column is needed to
  * show actual human readable dates.
@@ -285,6 +329,9 @@ QVariant FileSystemModel::data(const QModelIndex &index, int role) const
         switch (role) {
             case Qt::EditRole:
             case Qt::DisplayRole:
+                if (index.column() > Columns::Extension && fileSystemItem->getMetadataState() == FileSystemItem::MetadataPending)
+                    fileInfoRetriever->getItemMetadata(fileSystemItem);
+
                 switch (index.column()) {
                     case Columns::Name:
                         return QVariant(fileSystemItem->getDisplayName());
@@ -379,6 +426,9 @@ QVariant FileSystemModel::data(const QModelIndex &index, int role) const
             case FileSystemModel::RefCounterRole:
                 return fileSystemItem->getRefCounter();
 
+            case FileSystemModel::MetadataCompleteRole:
+                return fileSystemItem->isMetadataComplete();
+
         }
     }
     return QVariant();
@@ -453,8 +503,8 @@ bool FileSystemModel::canFetchMore(const QModelIndex &parent) const
  * If the children items of \a parent hasn't been fetched already, this function will start a
  * background process to fetch them.
  *
- * If this model is already fetching items for another \a parent, that fetching process will be canceled
- * by the FileInfoRetriever object, and start this one.
+ * If this model is already fetching items for another \a parent that no view is showing anymore, that fetching
+ * process will be canceled by the FileInfoRetriever object, and start this one.
  *
  * \sa FileInfoRetriever::getChildren
  *
@@ -468,6 +518,10 @@ void FileSystemModel::fetchMore(const QModelIndex &parent)
         // We don't care if fetchingMore was already true since FileInfoRetriever will cancel the current fetch
         if (!fileSystemItem->getLock() && !fileSystemItem->areAllChildrenFetched()) {
 
+            // Show the last known children right away and read the folder again in the background
+            if (loadCachedChildren(fileSystemItem))
+                return;
+
             fileSystemItem->setLock(true);
 
             QVector<int> roles;
@@ -479,6 +533,61 @@ void FileSystemModel::fetchMore(const QModelIndex &parent)
     }
 }
 
+/*!
+ * \brief Inserts the children of \a item saved in the listing cache.
+ * \param item a FileSystemItem folder without children.
+ * \return true if the cache had the children of \a item.
+ *
+ * The folder is then read again in the background, and only the differences are applied, so the view doesn't lose
+ * its scroll position or its selection. \sa refreshFolder
+ */
+bool FileSystemModel::loadCachedChildren(FileSystemItem *item)
+{
+    QList<FileSystemItem *> children;
+    bool modified;
+    if (!listingCache.load(item, children, modified))
+        return false;
+
+    // A folder that hasn't been modified has the same children, only their size and dates may have changed.  Where
+    // they're read by a pass of their own, that's all that is done, without listing the folder again
+    bool metadataOnly = !modified && fileInfoRetriever->isMetadataDeferred();
+    if (metadataOnly) {
+        for (FileSystemItem *child : qAsConst(children))
+            child->setMetadataState(FileSystemItem::MetadataPending);
+    }
+
+    QModelIndex parentIndex = index(item);
+
+    addMutex.lock();
+    if (!children.isEmpty()) {
+        beginInsertRows(parentIndex, 0, children.size() - 1);
+        for (FileSystemItem *child : children)
+            item->addChild(child);
+        endInsertRows();
+    }
+    addMutex.unlock();
+
+    item->setAllChildrenFetched(true);
+
+    if (watcher)
+        watcher->addItem(item);
+
+    QVector<int> roles;
+    roles.append(Qt::DisplayRole);
+    roles.append(FileSystemModel::AllChildrenFetchedRole);
+    emit dataChanged(parentIndex, parentIndex, roles);
+
+    // The sort models wait for the metadata, and the cached one is good enough to sort by
+    emit metadataFetched(parentIndex);
+
+    if (metadataOnly)
+        fileInfoRetriever->getMetadata(item, children);
+    else
+        refreshFolder(item);
+
+    return true;
+}
+
 void FileSystemModel::removeIndexes(QModelIndexList indexList, bool permanent)
 {
     qDebug() << "FileSystemModel::removeIndexes";
@@ -525,13 +634,32 @@ void FileSystemModel::refreshFolder(FileSystemItem *item)
 {
     qDebug() << "FileSystemModel::refreshFolder";
 
+    // This retriever only lists one folder, so it doesn't need the icon and metadata workers
     FileInfoRetriever *tempRetriever = new PlatformInfoRetriever();
+    tempRetriever->setWorkerCount(FileInfoRetriever::ListingJobs, 1);
+    tempRetriever->setWorkerCount(FileInfoRetriever::IconJobs, 0);
+    tempRetriever->setWorkerCount(FileInfoRetriever::MetadataJobs, 0);
+
+    // The new children are moved to the folder, they must not keep the blocks of the whole listing alive
+    tempRetriever->setUsingArenas(false);
+
+    // The folder may be removed before this retriever is done
+    QPersistentModelIndex itemIndex = index(item);
+
     connect(tempRetriever, &FileInfoRetriever::parentChildrenUpdated, [=](FileSystemItem *newParent) {
 
+            if (!itemIndex.isValid()) {
+                delete newParent;
+                tempRetriever->deleteLater();
+                return;
+            }
+
             // Compare folders
             QList<FileSystemItem *> newItemList = newParent->getChildren();
             QList<FileSystemItem *> itemList = item->getChildren();
 
+            bool changed {};
+
             // Remove old items and refresh current ones
             for (FileSystemItem *oldItem : itemList) {
 
@@ -541,6 +669,7 @@ void FileSystemModel::refreshFolder(FileSystemItem *item)
                     // This is an old item
                     qDebug() << "FileSystemModel::refreshFolder removing old item" << oldItem->getPath();
                     removePath(oldItem);
+                    changed = true;
                 }
             }
 
@@ -563,9 +692,14 @@ void FileSystemModel::refreshFolder(FileSystemItem *item)
                 } else {
                     // Compare items and refresh if needed
                     if (!newChild->isEqualTo(oldItem)) {
+
+                        // The children of the old item are still there
+                        bool allChildrenFetched = oldItem->areAllChildrenFetched();
                         newChild->cloneTo(oldItem);
+                        oldItem->setAllChildrenFetched(allChildrenFetched);
                         itemUpdated(oldItem);
                         iconUpdated(oldItem);
+                        changed = true;
                     }
                 }
             }
@@ -573,8 +707,13 @@ void FileSystemModel::refreshFolder(FileSystemItem *item)
             if (count > 0) {
                 beginInsertRows(index(item), row, row + count - 1);
                 endInsertRows();
+                changed = true;
             }
             addMutex.unlock();
+
+            if (changed && item->getRefCounter() > 0)
+                listingCache.save(item);
+
             delete newParent;
             tempRetriever->deleteLater();
     });
@@ -780,7 +919,18 @@ bool FileSystemModel::setData(const QModelIndex &index, const QVariant &value, i
                 }
                 break;
 
+            // The view is about to paint this folder and needs to know if it really has subfolders
+            case FileSystemModel::ProbeSubFoldersRole:
+                if (item->getSubFoldersState() == FileSystemItem::SubFoldersPending)
+                    fileInfoRetriever->getSubFolders(item);
+                break;
+
+            case FileSystemModel::PrefetchRole:
+                prefetch(item);
+                break;
+
             case FileSystemModel::IncreaseRefCounterRole:
+                usePrefetched(item);
                 item->incRefCounter();
                 garbageMutex.lock();
                 garbage.removeOne(item);
@@ -997,6 +1147,7 @@ void FileSystemModel::setRoot(const QString path)
     FileSystemItem *deleteLater = root;
     root = new FileSystemItem(path);
     root->setParent(nullptr);
+    root->setIndexed(true);
 
     fileInfoRetriever->getInfo(root);
     qDebug() << "FileSystemModel::setRoot root is ready" << path;
@@ -1006,11 +1157,8 @@ void FileSystemModel::setRoot(const QString path)
         qDebug() << "FileSystemModel::setRoot" << "freeing older root";
         watcher->removeItem(deleteLater);
 
-        // Process all dataChanged events that could still modify the old root structure
-        QApplication::processEvents();
-
-        // Finally delete the old root
-        delete deleteLater;
+        // Stop any job still working on the old root.  It's deleted after the signals already sent about it
+        fileInfoRetriever->deleteItem(deleteLater);
     }
 }
 
@@ -1030,7 +1178,7 @@ bool FileSystemModel::removeAllRows(const QModelIndex &parent)
         if (count > 0) {
 
             beginRemoveRows(parent, 0, count - 1);
-            item->removeChildren();
+            fileInfoRetriever->deleteChildren(item);
             endRemoveRows();
 
         } else {
@@ -1143,6 +1291,10 @@ void FileSystemModel::parentInfoUpdated(FileSystemItem *parent)
     qDebug() << "FileSystemModel::parentInfoUpdated endResetModel";
     endResetModel();
 
+    // An old root, replaced meanwhile
+    if (!isAttached(parent))
+        return;
+
     if (!parent->getErrorCode() && watcher) {
         watcher->addItem(parent);
     }
@@ -1160,32 +1312,97 @@ void FileSystemModel::parentInfoUpdated(FileSystemItem *parent)
     emit dataChanged(parentIndex, parentIndex, roles);
 }
 
+/*!
+ * \brief Inserts a batch of \a children of \a parent while it's still being fetched.
+ * \param parent a FileSystemItem folder being fetched.
+ * \param children the new children.
+ *
+ * The children are appended at the end of \a parent, so views can show the first rows of a folder without waiting for
+ * the whole folder to be read.
+ *
+ * \sa FileInfoRetriever::setStreaming
+ */
+void FileSystemModel::parentChildrenAdded(FileSystemItem *parent, QList<FileSystemItem *> children)
+{
+    if (children.isEmpty())
+        return;
+
+    // The folder was removed meanwhile.  The children are deleted with it
+    if (!isAttached(parent)) {
+        for (FileSystemItem *child : children)
+            parent->addChild(child);
+        return;
+    }
+
+    QModelIndex parentIndex = index(parent);
+
+    addMutex.lock();
+    int row = parent->childrenCount();
+
+    beginInsertRows(parentIndex, row, row + children.size() - 1);
+    for (FileSystemItem *child : children)
+        parent->addChild(child);
+    endInsertRows();
+
+    addMutex.unlock();
+}
+
 void FileSystemModel::parentChildrenUpdated(FileSystemItem *parent)
 {
+    // The folder was removed meanwhile
+    if (!isAttached(parent))
+        return;
+
     QModelIndex parentIndex = index(parent);
 
-    qDebug() << "FileSystemModel::parentInfoUpdated" << parent->childrenCount() << "children. Error code:" << parent->getErrorCode();
+    qDebug() << "FileSystemModel::parentChildrenUpdated" << parent->childrenCount() << "children. Error code:" << parent->getErrorCode();
 
     // This only happens if the user cancelled the fetch by selecting another index
+    // Remove all the children that were already inserted
     if (parent->getErrorCode() == -1) {
-        parent->removeChildren();
+        int count = parent->childrenCount();
+        if (count > 0) {
+            beginRemoveRows(parentIndex, 0, count - 1);
+            fileInfoRetriever->deleteChildren(parent);
+            endRemoveRows();
+        }
+        prefetchedCounts.remove(parent->getPath());
+        prefetchedPaths.removeOne(parent->getPath());
         parent->setLock(false);
         return;
     }
 
-    int count = parent->childrenCount();
+    // All the rows were already inserted by parentChildrenAdded
+    parent->setLock(false);
 
-    if (count > 0) {
-        beginInsertRows(parentIndex, 0, count - 1);
-        parent->setLock(false);
-        endInsertRows();
-    } else
-        parent->setLock(false);
+    // A folder fetched ahead of time that nobody has used yet
+    auto prefetched = prefetchedCounts.find(parent->getPath());
+    if (prefetched != prefetchedCounts.end()) {
+
+        // Errors are reported when the user actually opens the folder
+        if (parent->getErrorCode()) {
+            prefetchedCounts.erase(prefetched);
+            prefetchedPaths.removeOne(parent->getPath());
+            return;
+        }
+
+        prefetched.value() = parent->childrenCount();
+        prefetchedChildren += parent->childrenCount();
+        evictPrefetched();
+
+        // This folder alone was over the budget
+        if (!parent->areAllChildrenFetched())
+            return;
+    }
 
     if (!parent->getErrorCode() && watcher) {
         watcher->addItem(parent);
     }
 
+    // Without a metadata pass the listing is already complete \sa parentMetadataUpdated
+    if (!parent->getErrorCode() && !fileInfoRetriever->isMetadataDeferred() && parent->getRefCounter() > 0)
+        listingCache.save(parent);
+
     QVector<int> roles;
     if (!parent->getErrorCode()) {
         roles.append(Qt::DisplayRole);
@@ -1198,9 +1415,107 @@ void FileSystemModel::parentChildrenUpdated(FileSystemItem *parent)
     emit dataChanged(parentIndex, parentIndex, roles);
 }
 
+/*!
+ * \brief Sets the metadata of some \a children of \a parent and tells the views it's now available.
+ * \param parent a FileSystemItem folder.
+ * \param children a list of children of \a parent.
+ * \param metadata the metadata found for every child.
+ * \param firstRow the row where the children are expected to be, or -1 if unknown.
+ *
+ * The metadata is only set here, in the thread of the views, so it's never read while it's being written.
+ *
+ * The children are usually consecutive rows, so a single dataChanged signal is emitted for all of them.
+ *
+ * The signal is emitted only with MetadataCompleteRole, so a sort model won't move the rows one by one while the
+ * metadata is arriving. \sa parentMetadataUpdated
+ */
+void FileSystemModel::childrenMetadataUpdated(FileSystemItem *parent, QList<FileSystemItem *> children, QVector<FileInfoRetriever::Metadata> metadata, int firstRow)
+{
+    // The children removed meanwhile are not deleted yet \sa FileInfoRetriever::deleteItem
+    FileInfoRetriever::applyMetadata(children, metadata);
+
+    if (children.isEmpty() || !isAttached(parent))
+        return;
+
+    int count = parent->childrenCount();
+    int first = firstRow;
+    int last = firstRow + children.size() - 1;
+
+    // Children might have been removed meanwhile. Do not dereference them
+    if (first < 0 || last >= count || parent->getChildAt(first) != children.first() || parent->getChildAt(last) != children.last()) {
+
+        // Look for them in a single pass over the rows
+        QSet<FileSystemItem *> childrenSet;
+        childrenSet.reserve(children.size());
+        for (FileSystemItem *child : children)
+            childrenSet.insert(child);
+
+        first = count;
+        last = -1;
+        for (int row = 0; row < count; row++) {
+            if (childrenSet.contains(parent->getChildAt(row))) {
+                first = qMin(first, row);
+                last = qMax(last, row);
+            }
+        }
+
+        if (last < 0)
+            return;
+    }
+
+    // The link count of the folders may have told us whether they have subfolders
+    QVector<int> roles;
+    roles.append(FileSystemModel::MetadataCompleteRole);
+    roles.append(FileSystemModel::HasSubFoldersRole);
+
+    QModelIndex fromIndex = createIndex(first, Columns::Name, parent->getChildAt(first));
+    QModelIndex lastIndex = createIndex(last, Columns::LastChangeTime, parent->getChildAt(last));
+    emit dataChanged(fromIndex, lastIndex, roles);
+}
+
+/*!
+ * \brief Updates the expand indicator of \a item after it's known if it has subfolders.
+ * \param parent the parent of \a item.
+ * \param item a FileSystemItem folder.
+ */
+void FileSystemModel::subFoldersUpdated(FileSystemItem *parent, FileSystemItem *item)
+{
+    if (parent == nullptr || !isAttached(parent))
+        return;
+
+    // The item might have been removed meanwhile. Do not dereference it
+    int row = parent->findChildRow(item);
+    if (row < 0)
+        return;
+
+    QVector<int> roles;
+    roles.append(FileSystemModel::HasSubFoldersRole);
+
+    QModelIndex index = createIndex(row, 0, item);
+    emit dataChanged(index, index, roles);
+}
+
+/*!
+ * \brief Tells the sort models the metadata of all the children of \a parent is now available.
+ * \param parent a FileSystemItem folder.
+ */
+void FileSystemModel::parentMetadataUpdated(FileSystemItem *parent)
+{
+    if (!isAttached(parent))
+        return;
+
+    qDebug() << "FileSystemModel::parentMetadataUpdated" << parent->getPath();
+
+    // Only the folders the user is looking at are worth showing right away next time
+    if (parent->getRefCounter() > 0)
+        listingCache.save(parent);
+
+    emit metadataFetched(index(parent));
+}
+
 void FileSystemModel::itemUpdated(FileSystemItem *item)
 {
-    if (item != nullptr) {
+    if (item != nullptr && isAttached(item)) {
 
         FileSystemItem *parent = item->getParent();
 
@@ -1220,7 +1535,7 @@ void FileSystemModel::itemUpdated(FileSystemItem *item)
 
 void FileSystemModel::iconUpdated(FileSystemItem *item)
 {
-    if (item != nullptr) {
+    if (item != nullptr && isAttached(item)) {
 
         FileSystemItem *parent = item->getParent();
 
@@ -1275,12 +1590,9 @@ void FileSystemModel::renamePath(FileSystemItem *item, QString newFileName)
         fileInfoRetriever->refreshItem(item);
         fileInfoRetriever->getIcon(item);
 
-        if (item->isFolder()) {
-            fixChildrenPath(item);
-
-            // Refresh watchers
+        // The descendants of a folder follow it, only their watchers need a refresh
+        if (item->isFolder())
             watcher->refresh();
-        }
 
         QVector<int> roles;
         roles.append(Qt::DisplayRole);
@@ -1291,26 +1603,6 @@ void FileSystemModel::renamePath(FileSystemItem *item, QString newFileName)
 }
 
 
-void FileSystemModel::fixChildrenPath(FileSystemItem *item)
-{
-    QString path = item->getPath();
-
-    QList<FileSystemItem *>children = item->getChildren();
-    for (FileSystemItem *child : children) {
-
-        QString childPath = child->getPath();
-        int right = childPath.lastIndexOf(separator());
-        QString newPath = path + child->getPath().right(childPath.length() - right);
-
-        qDebug() << "FileSystemModel::fixChildrenPath changing" << child->getPath() << "to" << newPath;
-
-        item->updateChildPath(child, newPath);
-
-        if (child->isFolder())
-            fixChildrenPath(child);
-    }
-}
-
 void FileSystemModel::addPath(FileSystemItem *parentItem, QString fileName)
 {
     qDebug() << "FileSystemModel::addPath" << fileName;
@@ -1324,7 +1616,7 @@ void FileSystemModel::addPath(FileSystemItem *parentItem, QString fileName)
 
     addMutex.lock();
     FileSystemItem *fileSystemItem = parentItem->getChild(fileName);
-    if (fileSystemItem != nullptr) {
+    if (fileSystemItem != nullptr || pendingPathNames.contains(fileName)) {
         qDebug() << "FileSystemModel::addPath" << "we already have this path";
         addMutex.unlock();
         return;
@@ -1347,32 +1639,177 @@ void FileSystemModel::addPath(FileSystemItem *parentItem, QString fileName)
 
     fileInfoRetriever->getIcon(fileSystemItem, false);
 
-    int row = parentItem->childrenCount();
+    // A build or a copy adds many files in a burst, and every insertion makes the views place the new rows
+    PendingPaths &pending = pendingPaths[parentItem];
+    pending.parent = parentIndex;
+    pending.items.append(fileSystemItem);
+    pendingPathNames.insert(fileName);
+    addMutex.unlock();
 
-    beginInsertRows(parentIndex, row, row);
+    if (!pendingPathsTimer->isActive())
+        pendingPathsTimer->start();
+}
 
-    parentItem->addChild(fileSystemItem);
-    endInsertRows();
-    addMutex.unlock();
+/*!
+ * \brief Inserts the files added by the watcher since the last call.
+ *
+ * The new files of every folder are appended in a single block of rows, so every SortModel sorts them once and
+ * merges them into the rows it already has, instead of placing them one by one.
+ *
+ * \sa addPath
+ */
+void FileSystemModel::insertPendingPaths()
+{
+    addMutex.lock();
+    QHash<FileSystemItem *, PendingPaths> pending;
+    pending.swap(pendingPaths);
+    pendingPathNames.clear();
+
+    QList<FileSystemItem *> inserted;
+
+    for (auto it = pending.begin(); it != pending.end(); ++it) {
+
+        FileSystemItem *parentItem = it.key();
+        QList<FileSystemItem *> items;
+
+        // The folder might have been removed, and the files too
+        bool parentExists = it->parent.isValid() && it->parent.internalPointer() == parentItem;
+        for (FileSystemItem *item : it->items) {
+            if (parentExists && parentItem->getChild(item->getPath()) == nullptr && QFileInfo::exists(item->getPath()))
+                items.append(item);
+            else
+                delete item;
+        }
+
+        if (items.isEmpty())
+            continue;
+
+        int row = parentItem->childrenCount();
+
+        beginInsertRows(it->parent, row, row + items.size() - 1);
+        for (FileSystemItem *item : items)
+            parentItem->addChild(item);
+        endInsertRows();
 
-    qDebug() << "FileSystemModel::addPath row inserted for" << fileName;
+        qDebug() << "FileSystemModel::insertPendingPaths" << items.size() << "rows inserted for" << parentItem->getPath();
+
+        inserted.append(items);
+    }
+    addMutex.unlock();
 
     // If we were waiting for an item like this, tell the view the user has to set a new name for it
-    if (watch && parentItem == parentBeingWatched &&
-            ((extensionBeingWatched == "NewFolder" && fileSystemItem->isFolder()) ||
-                   extensionBeingWatched.right(extensionBeingWatched.size() - 1) == fileSystemItem->getExtension())) {
+    for (FileSystemItem *fileSystemItem : inserted) {
+        if (watch && fileSystemItem->getParent() == parentBeingWatched &&
+                ((extensionBeingWatched == "NewFolder" && fileSystemItem->isFolder()) ||
+                       extensionBeingWatched.right(extensionBeingWatched.size() - 1) == fileSystemItem->getExtension())) {
 
-        // Get icon now so it looks good when editing
-        fileInfoRetriever->getIcon(fileSystemItem, false);
+            // Get icon now so it looks good when editing
+            fileInfoRetriever->getIcon(fileSystemItem, false);
 
-        QModelIndex itemIndex = createIndex(row, 0, fileSystemItem);
-        QVector<int> roles;
-        roles.append(FileSystemModel::ShouldEditRole);
-        emit dataChanged(itemIndex, itemIndex, roles);
-        watch = false;
+            QModelIndex itemIndex = index(fileSystemItem);
+            QVector<int> roles;
+            roles.append(FileSystemModel::ShouldEditRole);
+            emit dataChanged(itemIndex, itemIndex, roles);
+            watch = false;
+        }
     }
 }
 
+/*!
+ * \brief Fetches the children of the folder \a item ahead of time, because the user is likely to open it soon.
+ * \param item a FileSystemItem folder.
+ *
+ * The folder is fetched with the lowest priority, so it never delays what the user is waiting for, and it's not
+ * cancelled when the user opens another folder.
+ *
+ * Prefetched folders that are not used are kept until their children exceed PREFETCH_BUDGET items, and then the
+ * least recently prefetched ones are emptied again.
+ */
+void FileSystemModel::prefetch(FileSystemItem *item)
+{
+    if (!item->isFolder() || item->getLock() || item->areAllChildrenFetched() || prefetchedChildren >= PREFETCH_BUDGET)
+        return;
+
+    item->setLock(true);
+
+    prefetchedCounts.insert(item->getPath(), -1);
+    prefetchedPaths.append(item->getPath());
+
+    fileInfoRetriever->getChildren(item, FileInfoRetriever::Prefetch);
+}
+
+/*!
+ * \brief Tells the prefetch policy the folder \a item is being used.
+ * \param item a FileSystemItem.
+ * \return true if \a item was prefetched.
+ *
+ * If \a item is still being fetched, its listing becomes a foreground one.
+ */
+bool FileSystemModel::usePrefetched(FileSystemItem *item)
+{
+    auto prefetched = prefetchedCounts.find(item->getPath());
+    if (prefetched == prefetchedCounts.end())
+        return false;
+
+    if (prefetched.value() < 0)
+        fileInfoRetriever->getChildren(item);
+    else
+        prefetchedChildren -= prefetched.value();
+
+    prefetchedCounts.erase(prefetched);
+    prefetchedPaths.removeOne(item->getPath());
+    return true;
+}
+
+/*!
+ * \brief Empties the least recently prefetched folders until their children are within PREFETCH_BUDGET items.
+ */
+void FileSystemModel::evictPrefetched()
+{
+    for (int i = 0; i < prefetchedPaths.size() && prefetchedChildren > PREFETCH_BUDGET; ) {
+
+        QString path = prefetchedPaths.at(i);
+        int count = prefetchedCounts.value(path);
+
+        // Still being fetched
+        if (count < 0) {
+            i++;
+            continue;
+        }
+
+        QModelIndex prefetchedIndex = index(path);
+        FileSystemItem *item = getFileSystemItem(prefetchedIndex);
+
+        if (item != nullptr && item->getRefCounter() == 0 && !item->getLock()) {
+            if (watcher != nullptr)
+                watcher->removeItem(item);
+            removeAllRows(prefetchedIndex);
+        }
+
+        prefetchedChildren -= count;
+        prefetchedCounts.remove(path);
+        prefetchedPaths.removeAt(i);
+    }
+}
+
+/*!
+ * \brief Returns true if \a item is still in the tree of this model.
+ *
+ * The items removed are deleted after the signals the FileInfoRetriever already sent about them, so the slots of those
+ * signals can still look at them, and this tells them apart.  \sa FileInfoRetriever::deleteItem
+ */
+bool FileSystemModel::isAttached(FileSystemItem *item) const
+{
+    while (item != root) {
+        FileSystemItem *parent = item->getParent();
+        if (parent == nullptr || parent->childRow(item) < 0)
+            return false;
+        item = parent;
+    }
+
+    return true;
+}
+
 void FileSystemModel::removePath(FileSystemItem *item)
 {
     if (item == nullptr)
@@ -1382,12 +1819,13 @@ void FileSystemModel::removePath(FileSystemItem *item)
 
     qDebug() << "FileSystemModel::removePath" << fileName;
 
+    // The watcher may still tell about an item that was removed meanwhile
+    if (!isAttached(item))
+        return;
+
     FileSystemItem *parentItem = item->getParent();
     QModelIndex parentIndex = index(parentItem);
 
-    if (!parentIndex.isValid())
-        return;
-
     int row = parentItem->childRow(item);
 
     if (row >= 0) {
@@ -1405,7 +1843,8 @@ void FileSystemModel::removePath(FileSystemItem *item)
             watcher->removeItem(item);
         }
 
-        delete item;
+        // The metadata pass of the parent, and the icon and metadata requests of the row, may still use it
+        fileInfoRetriever->deleteItem(item);
 
         qDebug() << "FileSystemModel::removePath" << fileName << "removed sucessfully. row =" << row;
     }
@@ -1418,7 +1857,8 @@ void FileSystemModel::garbageCollector()
     garbageMutex.lock();
     for (FileSystemItem *item : qAsConst(garbage)) {
 
-        if (item->getRefCounter() == 0) {
+        // Items being fetched are still receiving children
+        if (item->getRefCounter() == 0 && !item->getLock()) {
             watcher->removeItem(item);
 
             removeAllRows(index(item));
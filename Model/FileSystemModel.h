@@ -32,11 +32,13 @@
 
 #include <QAbstractItemModel>
 #include <QMutex>
+#include <QHash>
 
 #include "Shell/FileSystemItem.h"
 #include "Shell/FileInfoRetriever.h"
 #include "Shell/ShellActions.h"
 #include "Shell/DirectoryWatcher.h"
+#include "Shell/ListingCache.h"
 
 /*!
  * \brief FileSystemModel class.
@@ -49,6 +51,21 @@
  *
  * - Smart icon handling. Icons are fetch on demand.
  *
+ * - Children are inserted in batches while a folder is still being read, so the first rows of a huge folder are shown
+ *   right away. \sa parentChildrenAdded
+ *
+ * - Size, dates and type of the children may be retrieved after they are listed. Visible items get them first.
+ *   \sa childrenMetadataUpdated
+ *
+ * - Folders the user is likely to open next can be fetched ahead of time, within a budget of items.
+ *   \sa prefetch
+ *
+ * - The last known children of the folders the user looked at are saved on disk, so they are shown right away the next
+ *   time and then updated in the background. \sa ListingCache
+ *
+ * - Folders are shown as having subfolders until proven otherwise. Views ask for the real answer only for the rows
+ *   they paint. \sa setData \sa subFoldersUpdated
+ *
  * - It uses a DirectoryWatcher to add or remove files and folders that are new to or removed from the filesystem.
  *
  */
@@ -88,7 +105,10 @@ public:
         ErrorMessageRole,
         IncreaseRefCounterRole,
         DecreaseRefCounterRole,
-        RefCounterRole
+        RefCounterRole,
+        MetadataCompleteRole,
+        ProbeSubFoldersRole,
+        PrefetchRole
     };
 
     FileSystemModel(QObject *parent = nullptr, bool hasWatcher = true);
@@ -137,10 +157,17 @@ public:
         return static_cast<FileSystemItem *>(index.internalPointer());
     }
 
+signals:
+    void metadataFetched(const QModelIndex &parent);
+    void collationChanged();
+
 public slots:
     void refreshFolder(FileSystemItem *);
     void refreshIndex(QModelIndex index);
 
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
 private:
 
     FileInfoRetriever *fileInfoRetriever    {};
@@ -160,13 +187,39 @@ private:
     QMutex garbageMutex;
     QMutex addMutex;
 
+    // Files added by the watcher and not inserted yet, the ones of the same folder are inserted together
+    struct PendingPaths {
+        QPersistentModelIndex parent;
+        QList<FileSystemItem *> items;
+    };
+
+    QHash<FileSystemItem *, PendingPaths> pendingPaths  {};
+    QSet<QString> pendingPathNames                      {};
+    QTimer *pendingPathsTimer                           {};
+
+    ListingCache listingCache;
+
+    // Folders fetched ahead of time and not used yet, least recently prefetched first
+    QList<QString> prefetchedPaths          {};
+    QHash<QString, int> prefetchedCounts    {};     // Number of children of every folder, -1 while being fetched
+    int prefetchedChildren                  {};
+
     QString humanReadableSize(quint64 size) const;
+    void prefetch(FileSystemItem *item);
+    bool usePrefetched(FileSystemItem *item);
+    void evictPrefetched();
+    bool loadCachedChildren(FileSystemItem *item);
+    bool isAttached(FileSystemItem *item) const;
 
 private slots:
 
     // These slots are called by the FileInfoRetriever object
     void parentInfoUpdated(FileSystemItem *parent);
     void parentChildrenUpdated(FileSystemItem *parent);
+    void parentChildrenAdded(FileSystemItem *parent, QList<FileSystemItem *> children);
+    void parentMetadataUpdated(FileSystemItem *parent);
+    void childrenMetadataUpdated(FileSystemItem *parent, QList<FileSystemItem *> children, QVector<FileInfoRetriever::Metadata> metadata, int firstRow);
+    void subFoldersUpdated(FileSystemItem *parent, FileSystemItem *item);
     void itemUpdated(FileSystemItem *item);
     void iconUpdated(FileSystemItem *item);
 
@@ -175,10 +228,10 @@ private slots:
     void refreshPath(FileSystemItem *item);
     void addPath(FileSystemItem *parentItem, QString fileName);
     void removePath(FileSystemItem *item);
+    void insertPendingPaths();
 
     // Other slots
     void garbageCollector();
-    void fixChildrenPath(FileSystemItem *item);
 };
 
 #endif // FILESYSTEMMODEL_H
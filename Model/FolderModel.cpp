@@ -0,0 +1,297 @@
+#include "FolderModel.h"
+
+#include "Model/FileSystemModel.h"
+
+FolderModel::FolderModel(QObject *parent) : QAbstractProxyModel(parent)
+{
+}
+
+QModelIndex FolderModel::index(int row, int column, const QModelIndex &parent) const
+{
+    if (row < 0 || column < 0 || row >= rowCount(parent) || column >= columnCount(parent))
+        return QModelIndex();
+
+    // The top level is the same as the one of the source, only the root
+    if (!parent.isValid()) {
+        QModelIndex sourceIndex = sourceModel()->index(row, column);
+        return sourceIndex.isValid() ? createIndex(row, column, sourceIndex.internalPointer()) : QModelIndex();
+    }
+
+    FileSystemItem *parentItem = static_cast<FileSystemItem *>(parent.internalPointer());
+    return createIndex(row, column, parentItem->getFolderAt(row));
+}
+
+QModelIndex FolderModel::parent(const QModelIndex &index) const
+{
+    if (!index.isValid())
+        return QModelIndex();
+
+    FileSystemItem *parentItem = static_cast<FileSystemItem *>(index.internalPointer())->getParent();
+    if (parentItem == nullptr)
+        return QModelIndex();
+
+    FileSystemItem *grandParent = parentItem->getParent();
+    int row = (grandParent != nullptr) ? grandParent->folderRow(parentItem) : 0;
+    return createIndex(row, 0, parentItem);
+}
+
+int FolderModel::rowCount(const QModelIndex &parent) const
+{
+    if (sourceModel() == nullptr || parent.column() > 0)
+        return 0;
+
+    if (!parent.isValid())
+        return sourceModel()->rowCount();
+
+    return static_cast<FileSystemItem *>(parent.internalPointer())->foldersCount();
+}
+
+int FolderModel::columnCount(const QModelIndex &parent) const
+{
+    Q_UNUSED(parent)
+    return (sourceModel() != nullptr) ? sourceModel()->columnCount() : 0;
+}
+
+/*!
+ * \brief Returns the index of the FileSystemModel of the item of \a proxyIndex.
+ *
+ * Every item knows its row, so this takes constant time.
+ */
+QModelIndex FolderModel::mapToSource(const QModelIndex &proxyIndex) const
+{
+    if (!proxyIndex.isValid())
+        return QModelIndex();
+
+    QModelIndex sourceIndex = getFileSystemModel()->index(static_cast<FileSystemItem *>(proxyIndex.internalPointer()));
+    if (proxyIndex.column() == 0 || !sourceIndex.isValid())
+        return sourceIndex;
+
+    return sourceIndex.sibling(sourceIndex.row(), proxyIndex.column());
+}
+
+/*!
+ * \brief Returns the index of this model of the item of \a sourceIndex, or an invalid index if it's not a folder.
+ *
+ * The folders are kept in the order of their rows, so this is a binary search among them.
+ */
+QModelIndex FolderModel::mapFromSource(const QModelIndex &sourceIndex) const
+{
+    if (!sourceIndex.isValid())
+        return QModelIndex();
+
+    FileSystemItem *item = static_cast<FileSystemItem *>(sourceIndex.internalPointer());
+    FileSystemItem *parentItem = item->getParent();
+    if (parentItem == nullptr)
+        return createIndex(sourceIndex.row(), sourceIndex.column(), item);
+
+    int row = parentItem->folderRow(item);
+    return (row >= 0) ? createIndex(row, sourceIndex.column(), item) : QModelIndex();
+}
+
+void FolderModel::setSourceModel(QAbstractItemModel *sourceModel)
+{
+    beginResetModel();
+
+    if (this->sourceModel() != nullptr)
+        disconnect(this->sourceModel(), nullptr, this, nullptr);
+
+    QAbstractProxyModel::setSourceModel(sourceModel);
+
+    if (sourceModel != nullptr) {
+        connect(sourceModel, &QAbstractItemModel::rowsAboutToBeInserted, this, &FolderModel::sourceRowsAboutToBeInserted);
+        connect(sourceModel, &QAbstractItemModel::rowsInserted, this, &FolderModel::sourceRowsInserted);
+        connect(sourceModel, &QAbstractItemModel::rowsAboutToBeRemoved, this, &FolderModel::sourceRowsAboutToBeRemoved);
+        connect(sourceModel, &QAbstractItemModel::rowsRemoved, this, &FolderModel::sourceRowsRemoved);
+        connect(sourceModel, &QAbstractItemModel::dataChanged, this, &FolderModel::sourceDataChanged);
+        connect(sourceModel, &QAbstractItemModel::layoutAboutToBeChanged, this, &FolderModel::sourceLayoutAboutToBeChanged);
+        connect(sourceModel, &QAbstractItemModel::layoutChanged, this, &FolderModel::sourceLayoutChanged);
+        connect(sourceModel, &QAbstractItemModel::modelAboutToBeReset, this, [this]() { beginResetModel(); });
+        connect(sourceModel, &QAbstractItemModel::modelReset, this, [this]() { endResetModel(); });
+    }
+
+    endResetModel();
+}
+
+FileSystemModel *FolderModel::getFileSystemModel() const
+{
+    return reinterpret_cast<FileSystemModel *>(sourceModel());
+}
+
+/*!
+ * \brief Adds the children from \a first to \a last of \a sourceParent to its folders, or takes them out of them,
+ * if their type changed.
+ *
+ * The retriever may find out that an item is a folder, or not anymore, in any thread, and then the FileSystemModel
+ * tells the views the item changed.  The folders are only updated here, so the views are told first.
+ */
+void FolderModel::updateFolders(const QModelIndex &sourceParent, int first, int last)
+{
+    FileSystemItem *parentItem = static_cast<FileSystemItem *>(sourceParent.internalPointer());
+    QModelIndex parent = mapFromSource(sourceParent);
+
+    for (int row = first; row <= last; row++) {
+
+        FileSystemItem *child = parentItem->getChildAt(row);
+        int folder = parentItem->folderRow(child);
+        if (child->isFolderOrDrive() == (folder >= 0))
+            continue;
+
+        // Nobody is showing the folders of a parent that is not a folder itself
+        if (!parent.isValid()) {
+            parentItem->updateFolder(child);
+            continue;
+        }
+
+        if (folder < 0) {
+            folder = parentItem->foldersBefore(row);
+            beginInsertRows(parent, folder, folder);
+            parentItem->updateFolder(child);
+            endInsertRows();
+        } else {
+            beginRemoveRows(parent, folder, folder);
+            parentItem->updateFolder(child);
+            endRemoveRows();
+        }
+    }
+}
+
+void FolderModel::sourceRowsAboutToBeInserted(const QModelIndex &parent, int first, int last)
+{
+    if (!parent.isValid())
+        beginInsertRows(QModelIndex(), first, last);
+}
+
+/*!
+ * \brief Adds the folders among the children from \a first to \a last just inserted in \a parent to its folders.
+ *
+ * The children are not added to the folders of their parent with them, so the folders are only added here, between
+ * beginInsertRows() and endInsertRows() like any other change of this model.
+ */
+void FolderModel::sourceRowsInserted(const QModelIndex &parent, int first, int last)
+{
+    if (!parent.isValid()) {
+        endInsertRows();
+        return;
+    }
+
+    FileSystemItem *parentItem = static_cast<FileSystemItem *>(parent.internalPointer());
+
+    QList<FileSystemItem *> folders;
+    for (int row = first; row <= last; row++) {
+        FileSystemItem *child = parentItem->getChildAt(row);
+        if (child->isFolderOrDrive())
+            folders.append(child);
+    }
+
+    if (folders.isEmpty())
+        return;
+
+    // Nobody is showing the folders of a parent that is not a folder itself
+    QModelIndex proxyParent = mapFromSource(parent);
+    if (!proxyParent.isValid()) {
+        for (FileSystemItem *folder : qAsConst(folders))
+            parentItem->updateFolder(folder);
+        return;
+    }
+
+    int firstFolder = parentItem->foldersBefore(first);
+    beginInsertRows(proxyParent, firstFolder, firstFolder + folders.size() - 1);
+    for (FileSystemItem *folder : qAsConst(folders))
+        parentItem->updateFolder(folder);
+    endInsertRows();
+}
+
+void FolderModel::sourceRowsAboutToBeRemoved(const QModelIndex &parent, int first, int last)
+{
+    if (!parent.isValid()) {
+        beginRemoveRows(QModelIndex(), first, last);
+        removing.append(true);
+        return;
+    }
+
+    QModelIndex proxyParent = mapFromSource(parent);
+    FileSystemItem *parentItem = static_cast<FileSystemItem *>(parent.internalPointer());
+    int firstFolder = parentItem->foldersBefore(first);
+    int lastFolder = parentItem->foldersBefore(last + 1) - 1;
+
+    bool folders = proxyParent.isValid() && firstFolder <= lastFolder;
+    if (folders)
+        beginRemoveRows(proxyParent, firstFolder, lastFolder);
+
+    removing.append(folders);
+}
+
+void FolderModel::sourceRowsRemoved(const QModelIndex &parent, int first, int last)
+{
+    Q_UNUSED(parent)
+    Q_UNUSED(first)
+    Q_UNUSED(last)
+
+    if (!removing.isEmpty() && removing.takeLast())
+        endRemoveRows();
+}
+
+/*!
+ * \brief Tells the views about the folders among the children from \a topLeft to \a bottomRight that changed.
+ *
+ * Only the changes of the whole item may change its type, the ones of its metadata or its icon don't.
+ */
+void FolderModel::sourceDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight, const QVector<int> &roles)
+{
+    QModelIndex parent = topLeft.parent();
+    if (!parent.isValid()) {
+        emit dataChanged(mapFromSource(topLeft), mapFromSource(bottomRight), roles);
+        return;
+    }
+
+    if (roles.isEmpty() || roles.contains(Qt::DisplayRole))
+        updateFolders(parent, topLeft.row(), bottomRight.row());
+
+    QModelIndex proxyParent = mapFromSource(parent);
+    if (!proxyParent.isValid())
+        return;
+
+    FileSystemItem *parentItem = static_cast<FileSystemItem *>(parent.internalPointer());
+    int firstFolder = parentItem->foldersBefore(topLeft.row());
+    int lastFolder = parentItem->foldersBefore(bottomRight.row() + 1) - 1;
+
+    if (firstFolder <= lastFolder)
+        emit dataChanged(index(firstFolder, topLeft.column(), proxyParent), index(lastFolder, bottomRight.column(), proxyParent), roles);
+}
+
+void FolderModel::sourceLayoutAboutToBeChanged()
+{
+    emit layoutAboutToBeChanged();
+
+    layoutIndexes = persistentIndexList();
+    for (const QModelIndex &index : qAsConst(layoutIndexes))
+        layoutItems.append(static_cast<FileSystemItem *>(index.internalPointer()));
+}
+
+/*!
+ * \brief Moves the persistent indexes to the new rows of their items.
+ */
+void FolderModel::sourceLayoutChanged()
+{
+    QModelIndexList newIndexes;
+    newIndexes.reserve(layoutIndexes.size());
+
+    for (int i = 0; i < layoutIndexes.size(); i++) {
+        FileSystemItem *item = layoutItems.at(i);
+        FileSystemItem *parentItem = item->getParent();
+        int column = layoutIndexes.at(i).column();
+
+        if (parentItem == nullptr) {
+            newIndexes.append(layoutIndexes.at(i));
+        } else {
+            int row = parentItem->folderRow(item);
+            newIndexes.append((row >= 0) ? createIndex(row, column, item) : QModelIndex());
+        }
+    }
+
+    changePersistentIndexList(layoutIndexes, newIndexes);
+    layoutIndexes.clear();
+    layoutItems.clear();
+
+    emit layoutChanged();
+}
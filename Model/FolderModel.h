@@ -0,0 +1,56 @@
+#ifndef FOLDERMODEL_H
+#define FOLDERMODEL_H
+
+#include <QAbstractProxyModel>
+#include <QVector>
+
+class FileSystemItem;
+class FileSystemModel;
+
+/*!
+ * \brief A model with only the folders and drives of a FileSystemModel.
+ *
+ * The rows of a folder are the folders kept apart by its FileSystemItem, so the tree on top of this model never sees
+ * the files, and a folder with a hundred thousand files and ten subfolders costs it ten rows.
+ *
+ * The indexes point to the same items as the ones of the FileSystemModel, and only the rows change.
+ *
+ * \sa FileSystemItem::foldersCount
+ */
+class FolderModel : public QAbstractProxyModel
+{
+    Q_OBJECT
+
+public:
+    FolderModel(QObject *parent = nullptr);
+
+    QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const override;
+    QModelIndex parent(const QModelIndex &index) const override;
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+
+    QModelIndex mapToSource(const QModelIndex &proxyIndex) const override;
+    QModelIndex mapFromSource(const QModelIndex &sourceIndex) const override;
+
+    void setSourceModel(QAbstractItemModel *sourceModel) override;
+    FileSystemModel *getFileSystemModel() const;
+
+private:
+    QVector<bool> removing              {};     // Whether every removal being done removes folders
+
+    QModelIndexList layoutIndexes       {};
+    QList<FileSystemItem *> layoutItems {};
+
+    void updateFolders(const QModelIndex &sourceParent, int first, int last);
+
+private slots:
+    void sourceRowsAboutToBeInserted(const QModelIndex &parent, int first, int last);
+    void sourceRowsInserted(const QModelIndex &parent, int first, int last);
+    void sourceRowsAboutToBeRemoved(const QModelIndex &parent, int first, int last);
+    void sourceRowsRemoved(const QModelIndex &parent, int first, int last);
+    void sourceDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight, const QVector<int> &roles);
+    void sourceLayoutAboutToBeChanged();
+    void sourceLayoutChanged();
+};
+
+#endif // FOLDERMODEL_H
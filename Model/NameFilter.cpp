@@ -0,0 +1,186 @@
+#include <QtAlgorithms>
+#include <QTime>
+#include <QDebug>
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "NameFilter.h"
+
+#include "Shell/FileSystemItem.h"
+
+namespace {
+
+/*!
+ * \brief Returns the first \a needle of \a length characters between \a from and \a end, or nullptr if there's none.
+ */
+const ushort *find(const ushort *from, const ushort *end, const ushort *needle, int length)
+{
+    if (end - from < length)
+        return nullptr;
+
+    // The last place where the needle fits
+    const ushort *last = end - length;
+    size_t restSize = static_cast<size_t>(length - 1) * sizeof(ushort);
+    const ushort *p = from;
+
+#ifdef __SSE2__
+    // Look for the first character in eight characters at a time, and compare the rest only where it's found
+    const __m128i first = _mm_set1_epi16(static_cast<short>(needle[0]));
+    for (; p + 8 <= end; p += 8) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        uint mask = static_cast<uint>(_mm_movemask_epi8(_mm_cmpeq_epi16(chunk, first)));
+
+        while (mask != 0) {
+            const ushort *candidate = p + qCountTrailingZeroBits(mask) / 2;
+            if (candidate > last)
+                return nullptr;
+
+            if (memcmp(candidate + 1, needle + 1, restSize) == 0)
+                return candidate;
+
+            // Every character sets two bits
+            mask &= mask - 1;
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    for (; p <= last; p++) {
+        if (*p == needle[0] && memcmp(p + 1, needle + 1, restSize) == 0)
+            return p;
+    }
+
+    return nullptr;
+}
+
+}
+
+/*!
+ * \brief Finds the children of \a folder whose names contain \a query.
+ * \param folder a FileSystemItem folder.
+ * \param query a text that is not empty.
+ */
+void NameFilter::setQuery(FileSystemItem *folder, const QString &query)
+{
+    QTime start;
+    start.start();
+
+    QString folded = query.toCaseFolded();
+
+    if (folder != this->folder) {
+        this->folder = folder;
+        valid = false;
+    }
+
+    bool grows = valid && !this->query.isEmpty() && folded.contains(this->query);
+    this->query = folded;
+
+    if (!valid) {
+        build();
+        scan();
+    } else if (grows)
+        refine();
+    else
+        scan();
+
+    qDebug() << "NameFilter::setQuery" << matches.count(true) << "of" << matches.size() << "children match" << query
+             << "in" << start.elapsed() << "milliseconds" << (grows ? "(refined)" : "");
+}
+
+void NameFilter::clear()
+{
+    folder = nullptr;
+    query.clear();
+    valid = false;
+    names.clear();
+    starts.clear();
+    matches.clear();
+}
+
+/*!
+ * \brief Makes the buffer again the next time it's used, because the children of the folder changed.
+ */
+void NameFilter::invalidate()
+{
+    valid = false;
+}
+
+/*!
+ * \brief Returns true if the name of the child at \a row contains the query.
+ */
+bool NameFilter::accepts(int row)
+{
+    if (!valid) {
+        build();
+        scan();
+    }
+
+    return row < matches.size() && matches.testBit(row);
+}
+
+bool NameFilter::isActive() const
+{
+    return folder != nullptr;
+}
+
+void NameFilter::build()
+{
+    int count = folder->childrenCount();
+
+    names.clear();
+    starts.resize(count + 1);
+
+    for (int row = 0; row < count; row++) {
+        starts[row] = names.size();
+        names.append(folder->getChildAt(row)->getDisplayName().toCaseFolded());
+        names.append(QChar());
+    }
+    starts[count] = names.size();
+
+    valid = true;
+}
+
+/*!
+ * \brief Looks for the query in the names of all the children.
+ *
+ * After a match the scan goes on from the next name, since the row already matched.
+ */
+void NameFilter::scan()
+{
+    int count = starts.size() - 1;
+    matches.fill(false, count);
+
+    const ushort *buffer = names.utf16();
+    const ushort *end = buffer + names.size();
+    const ushort *p = buffer;
+    int row = 0;
+
+    while ((p = find(p, end, query.utf16(), query.size())) != nullptr) {
+        int offset = static_cast<int>(p - buffer);
+        row = static_cast<int>(std::upper_bound(starts.cbegin() + row, starts.cend(), offset) - starts.cbegin()) - 1;
+        matches.setBit(row);
+        p = buffer + starts.at(row + 1);
+    }
+}
+
+/*!
+ * \brief Looks for the query only in the names that matched a shorter query contained in it.
+ */
+void NameFilter::refine()
+{
+    const ushort *buffer = names.utf16();
+
+    for (int row = 0; row < matches.size(); row++) {
+        if (matches.testBit(row)) {
+            // Skip the zero at the end of the name
+            const ushort *end = buffer + starts.at(row + 1) - 1;
+            if (find(buffer + starts.at(row), end, query.utf16(), query.size()) == nullptr)
+                matches.clearBit(row);
+        }
+    }
+}
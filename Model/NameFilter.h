@@ -0,0 +1,45 @@
+#ifndef NAMEFILTER_H
+#define NAMEFILTER_H
+
+#include <QBitArray>
+#include <QString>
+#include <QVector>
+
+class FileSystemItem;
+
+/*!
+ * \brief Finds the children of a folder whose names contain a text, ignoring the case.
+ *
+ * The case folded names of all the children are copied once into a single buffer, separated by zeros, which is then
+ * scanned for the text eight characters at a time.  No name has a zero, so a match never spans two names.
+ *
+ * When the text only grows, the children that didn't match before can't match now, so only the ones that matched are
+ * looked at again.
+ *
+ * The buffer is made again after the children of the folder change. \sa invalidate
+ */
+class NameFilter
+{
+public:
+    void setQuery(FileSystemItem *folder, const QString &query);
+    void clear();
+    void invalidate();
+
+    bool accepts(int row);
+    bool isActive() const;
+
+private:
+    FileSystemItem *folder      {};
+    QString query               {};
+    bool valid                  {};     // The buffer has the names of the current children of the folder
+
+    QString names               {};
+    QVector<int> starts         {};     // Where the name of every row starts, and the end of the buffer
+    QBitArray matches           {};
+
+    void build();
+    void scan();
+    void refine();
+};
+
+#endif // NAMEFILTER_H
@@ -0,0 +1,85 @@
+#ifndef RANKS_H
+#define RANKS_H
+
+#include <QVector>
+
+#include <algorithm>
+#include <iterator>
+#include <numeric>
+
+/*!
+ * \brief Keeps the positions of the children of a folder once sorted, indexed by their rows, as rows are inserted and
+ * removed.
+ *
+ * The rows already ranked keep their order, so new rows are merged into them instead of ranking the whole folder
+ * again. \sa SortModel::rank
+ */
+class Ranks
+{
+public:
+
+    /*!
+     * \brief Ranks the \a count rows just inserted at \a first among the rows already in \a ranks.
+     * \param less compares two rows with their new numbers, the way they're sorted.
+     *
+     * The new rows are sorted, and then every one of them is placed with a binary search starting where the previous
+     * one was placed, so adding k rows to n costs O(k log n) comparisons.
+     */
+    template <typename LessThan>
+    static void insert(QVector<int> &ranks, int first, int count, LessThan less)
+    {
+        int total = ranks.size() + count;
+
+        // The rows already ranked in order, with their new numbers
+        QVector<int> rows(ranks.size());
+        for (int row = 0; row < ranks.size(); row++)
+            rows[ranks.at(row)] = (row < first) ? row : row + count;
+
+        QVector<int> newRows(count);
+        std::iota(newRows.begin(), newRows.end(), first);
+        std::stable_sort(newRows.begin(), newRows.end(), less);
+
+        QVector<int> merged;
+        merged.reserve(total);
+
+        auto from = rows.cbegin();
+        for (int row : qAsConst(newRows)) {
+            auto to = std::upper_bound(from, rows.cend(), row, less);
+            std::copy(from, to, std::back_inserter(merged));
+            merged.append(row);
+            from = to;
+        }
+        std::copy(from, rows.cend(), std::back_inserter(merged));
+
+        ranks.resize(total);
+        for (int position = 0; position < total; position++)
+            ranks[merged.at(position)] = position;
+    }
+
+    /*!
+     * \brief Removes the rows from \a first to \a last from \a ranks.
+     *
+     * The rest keep their order, they're only numbered again.
+     */
+    static void remove(QVector<int> &ranks, int first, int last)
+    {
+        int count = last - first + 1;
+
+        QVector<int> rows(ranks.size(), -1);
+        for (int row = 0; row < ranks.size(); row++) {
+            if (row < first || row > last)
+                rows[ranks.at(row)] = (row < first) ? row : row - count;
+        }
+
+        QVector<int> newRanks(ranks.size() - count);
+        int position = 0;
+        for (int row : qAsConst(rows)) {
+            if (row >= 0)
+                newRanks[row] = position++;
+        }
+
+        ranks.swap(newRanks);
+    }
+};
+
+#endif // RANKS_H
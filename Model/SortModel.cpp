@@ -1,44 +1,271 @@
+#include <QtConcurrent/QtConcurrentRun>
+#include <QFuture>
+#include <QThread>
+#include <QTimer>
+#include <QTime>
 #include <QDebug>
 
+#include <algorithm>
+#include <numeric>
+#include <cstring>
+
 #include "SortModel.h"
 
 #include "Model/FileSystemModel.h"
+#include "Model/Ranks.h"
+#include "Shell/Collation.h"
+#include "Settings/Settings.h"
+
+// Folders with at least this many children are sorted with all the cores, unless the settings say otherwise
+#define PARALLEL_SORT_THRESHOLD     20000
+
+// Rows changed within this many milliseconds of the last move are moved together, at most this often
+#define RESORT_INTERVAL             250
+
+// Indexed by FileSystemModel::Columns
+const SortModel::Comparator SortModel::comparators[] = {
+    &SortModel::compareNames,
+    &SortModel::compareExtensions,
+    &SortModel::compareSizes,
+    &SortModel::compareTypes,
+    &SortModel::compareLastChangeTimes
+};
 
 SortModel::SortModel(QObject *parent) : QSortFilterProxyModel(parent)
 {
-    UErrorCode status = U_ZERO_ERROR;
-    coll = icu::Collator::createInstance(icu::Locale::getDefault(), status);
-    coll->setAttribute(UCOL_NUMERIC_COLLATION, UCOL_ON, status);
+    static_assert(sizeof(comparators) / sizeof(comparators[0]) == FileSystemModel::MaxColumns,
+                  "There must be a comparator for every column");
+
+    parallelSortThreshold = PARALLEL_SORT_THRESHOLD;
+    if (Settings::settings != nullptr)
+        parallelSortThreshold = Settings::settings->readGlobalSetting(SETTINGS_GLOBAL_PARALLEL_SORT_THRESHOLD).toInt(PARALLEL_SORT_THRESHOLD);
+
+    resortTimer = new QTimer(this);
+    resortTimer->setSingleShot(true);
+    resortTimer->setInterval(RESORT_INTERVAL);
+    connect(resortTimer, &QTimer::timeout, this, [this]() {
+        if (resortPending)
+            resort();
+    });
+}
+
+void SortModel::setSourceModel(QAbstractItemModel *sourceModel)
+{
+    if (this->sourceModel() != nullptr) {
+        disconnect(this->sourceModel(), nullptr, this, nullptr);
+        disconnect(getFileSystemModel(), nullptr, this, nullptr);
+    }
+
+    // These are connected before the ones of QSortFilterProxyModel, so the rankings are dropped before it uses them
+    connect(sourceModel, &QAbstractItemModel::rowsAboutToBeInserted, this, [this]() { updating = true; });
+    connect(sourceModel, &QAbstractItemModel::rowsInserted, this, &SortModel::invalidateNameFilter);
+    connect(sourceModel, &QAbstractItemModel::rowsRemoved, this, &SortModel::invalidateNameFilter);
+    connect(sourceModel, &QAbstractItemModel::rowsInserted, this, &SortModel::insertRanks);
+    connect(sourceModel, &QAbstractItemModel::rowsRemoved, this, &SortModel::removeRanks);
+    connect(sourceModel, &QAbstractItemModel::dataChanged, this,
+            [this](const QModelIndex &topLeft, const QModelIndex &, const QVector<int> &roles) {
+        // Ignore the changes that don't move rows, like new icons.  The metadata changes the other columns.
+        if (roles.isEmpty() || roles.contains(sortRole()) || roles.contains(FileSystemModel::MetadataCompleteRole)) {
+            dropRanking(topLeft.parent());
+            updating = true;
+        }
+        if (roles.isEmpty() || roles.contains(Qt::DisplayRole))
+            invalidateNameFilter(topLeft.parent());
+        deferResort(roles);
+    });
+    connect(sourceModel, &QAbstractItemModel::rowsAboutToBeMoved, this, [this]() { rankings.clear(); });
+    connect(sourceModel, &QAbstractItemModel::layoutAboutToBeChanged, this, [this]() { rankings.clear(); });
+    connect(sourceModel, &QAbstractItemModel::modelAboutToBeReset, this, [this]() { rankings.clear(); });
+
+    QSortFilterProxyModel::setSourceModel(sourceModel);
+
+    // And these after them, QSortFilterProxyModel places the new or changed rows one by one in between
+    connect(sourceModel, &QAbstractItemModel::rowsInserted, this, [this]() { updating = false; });
+    connect(sourceModel, &QAbstractItemModel::dataChanged, this, [this]() { updating = false; });
+
+    // Rows are not moved while the metadata of a folder is arriving, so sort again when it's complete
+    FileSystemModel *model = getFileSystemModel();
+    connect(model, &FileSystemModel::metadataFetched, this, [this](const QModelIndex &parent) {
+        int column = sortColumn();
+        if (mapFromFileSystemModel(parent).isValid() &&
+                (column == FileSystemModel::Size || column == FileSystemModel::Type || column == FileSystemModel::LastChangeTime))
+            resort();
+    });
+
+    // Sort again with the collation of the new locale
+    connect(model, &FileSystemModel::collationChanged, this, [this]() {
+        rankings.clear();
+        invalidate();
+    });
+}
+
+/*!
+ * \brief Sorts all the rows again in a single layout change.
+ *
+ * The persistent indexes are kept, so the views keep their current item and their selection.
+ */
+void SortModel::resort()
+{
+    resortTimer->stop();
+    resortPending = false;
+
+    // QSortFilterProxyModel sorts when the dynamic sort is turned on
+    setDynamicSortFilter(false);
+    setDynamicSortFilter(true);
+}
+
+/*!
+ * \brief Shows only the children of \a parent whose names contain \a text, ignoring the case.
+ * \param parent an index of this model, usually the root index of the view.
+ * \param text the text to look for, or an empty text to show all the children again.
+ *
+ * \sa NameFilter
+ */
+void SortModel::setNameFilter(const QModelIndex &parent, const QString &text)
+{
+    QModelIndex sourceParent = mapToSource(parent);
+
+    if (text.isEmpty() || !sourceParent.isValid()) {
+        if (nameFilter.isActive()) {
+            nameFilter.clear();
+            filterParent = QPersistentModelIndex();
+            invalidateFilter();
+        }
+        return;
+    }
+
+    filterParent = sourceParent;
+    nameFilter.setQuery(reinterpret_cast<FileSystemItem *>(sourceParent.internalPointer()), text);
+    invalidateFilter();
+}
+
+bool SortModel::filterAcceptsRow(int source_row, const QModelIndex &source_parent) const
+{
+    if (!nameFilter.isActive() || !filterParent.isValid() || filterParent != source_parent)
+        return true;
+
+    return nameFilter.accepts(source_row);
+}
+
+void SortModel::invalidateNameFilter(const QModelIndex &parent)
+{
+    if (nameFilter.isActive() && filterParent == parent)
+        nameFilter.invalidate();
 }
 
-SortModel::~SortModel()
+/*!
+ * \brief Leaves the rows changed by a burst of updates in place, and moves them all together later.
+ * \param roles the roles of the rows about to change.
+ *
+ * The first change moves its rows right away.  The ones that follow within RESORT_INTERVAL milliseconds turn off the
+ * dynamic sort of QSortFilterProxyModel, which would otherwise move every row as soon as it changes, and the rows are
+ * sorted once when the interval ends.  A folder getting its metadata or being refreshed is sorted at most a few times
+ * per second, instead of once per item, and the rows don't jump around.
+ */
+void SortModel::deferResort(const QVector<int> &roles)
 {
-    if (coll != nullptr)
-        delete coll;
+    if (!roles.isEmpty() && !roles.contains(sortRole()))
+        return;
+
+    if (resortTimer->isActive()) {
+        if (!resortPending) {
+            resortPending = true;
+            setDynamicSortFilter(false);
+        }
+    } else
+        resortTimer->start();
 }
 
 bool SortModel::willRecycle(const QModelIndex &index)
 {
-    FileSystemModel *model = reinterpret_cast<FileSystemModel *>(sourceModel());
-    return model->willRecycle(mapToSource(index));
+    return getFileSystemModel()->willRecycle(mapToFileSystemModel(index));
 }
 
 void SortModel::removeIndexes(QModelIndexList indexList, bool permanent)
 {
     QModelIndexList sourceIndexList;
     for (QModelIndex index : indexList)
-        sourceIndexList.append(mapToSource(index));
-    FileSystemModel *model = reinterpret_cast<FileSystemModel *>(sourceModel());
-    model->removeIndexes(sourceIndexList, permanent);
+        sourceIndexList.append(mapToFileSystemModel(index));
+    getFileSystemModel()->removeIndexes(sourceIndexList, permanent);
 }
 
-bool SortModel::lessThan(const QModelIndex &source_left, const QModelIndex &source_right) const
+/*!
+ * \brief Returns the FileSystemModel under this model.
+ *
+ * It's the source model, unless a subclass places another model in between. \sa TreeModel
+ */
+FileSystemModel *SortModel::getFileSystemModel() const
 {
-    bool comparison;
-    bool result = (sortOrder() == Qt::AscendingOrder);
+    return reinterpret_cast<FileSystemModel *>(sourceModel());
+}
+
+/*!
+ * \brief Returns the index of the FileSystemModel that corresponds to \a proxyIndex.
+ */
+QModelIndex SortModel::mapToFileSystemModel(const QModelIndex &proxyIndex) const
+{
+    return mapToSource(proxyIndex);
+}
+
+/*!
+ * \brief Returns the index of this model that corresponds to \a modelIndex of the FileSystemModel.
+ */
+QModelIndex SortModel::mapFromFileSystemModel(const QModelIndex &modelIndex) const
+{
+    return mapFromSource(modelIndex);
+}
+
+/*!
+ * \brief Ranks the children of the folders with at least \a value children with all the cores, or never if it's 0.
+ */
+void SortModel::setParallelSortThreshold(int value)
+{
+    parallelSortThreshold = value;
+    rankings.clear();
+}
 
+/*!
+ * \brief Compares two rows of the source model.
+ *
+ * The rows of large folders are ranked first with all the cores, and then they're compared by their ranks.  The
+ * ranks are kept until the folder changes.  Rows inserted or changed one by one are compared as usual.
+ *
+ * \sa rank
+ */
+bool SortModel::lessThan(const QModelIndex &source_left, const QModelIndex &source_right) const
+{
     FileSystemItem *i = reinterpret_cast<FileSystemItem *>(source_left.internalPointer());
     FileSystemItem *j = reinterpret_cast<FileSystemItem *>(source_right.internalPointer());
+    FileSystemItem *parent = i->getParent();
+
+    if (parent != nullptr && parent == j->getParent()) {
+        const Ranking *ranking = findRanking(parent);
+
+        if (ranking == nullptr && !updating && parallelSortThreshold > 0 && parent->childrenCount() >= parallelSortThreshold)
+            ranking = rank(source_left.parent(), parent);
+
+        if (ranking != nullptr) {
+            int left = ranking->ranks.at(source_left.row());
+            int right = ranking->ranks.at(source_right.row());
+            return (sortOrder() == Qt::AscendingOrder) ? (left < right) : (right < left);
+        }
+    }
+
+    return lessThan(i, j);
+}
+
+/*!
+ * \brief Compares two items by the sort column, and by their names if they're equal.
+ *
+ * Every column has its own comparator that reads the fields of the items directly, so nothing is allocated here.
+ * Names, extensions and types are compared through their collation keys, which are made once, so this is just a
+ * strcmp() most of the time. \sa FileSystemItem::getSortKey
+ *
+ * This can be called from several threads at the same time, once the keys of the items are made. \sa rank
+ */
+bool SortModel::lessThan(const FileSystemItem *i, const FileSystemItem *j) const
+{
+    bool result = (sortOrder() == Qt::AscendingOrder);
 
     // Folders are first
     if (i->isFolder() && !j->isFolder())
@@ -49,44 +276,234 @@ bool SortModel::lessThan(const QModelIndex &source_left, const QModelIndex &sour
         return result;
 
     // Drives are third
-    if (i->isDrive() && j->isDrive()) {
+    if (i->isDrive() && j->isDrive())
+        return Collation::compare(i->getPath(), j->getPath()) < 0;
+
+    // If both items are files or both are folders then direct comparison is allowed
+    if ((!i->isFolder() && !j->isFolder()) || (i->isFolder() && j->isFolder())) {
+        int column = sortColumn();
+        int difference = (column >= 0 && column < FileSystemModel::MaxColumns) ? (this->*comparators[column])(i, j) : 0;
 
-        i->getPath().utf16();
-        comparison = (coll->compare(reinterpret_cast<const char16_t *>(i->getPath().utf16()), i->getPath().length(),
-                                    reinterpret_cast<const char16_t *>(j->getPath().utf16()), j->getPath().length()) < 0);
+        if (difference == 0 && column != FileSystemModel::Name)
+            difference = compareNames(i, j);
 
-        return comparison;
+        return difference < 0;
     }
 
+    return false;
+}
+
+int SortModel::compareNames(const FileSystemItem *i, const FileSystemItem *j) const
+{
+    return strcmp(i->getSortKey(), j->getSortKey());
+}
+
+int SortModel::compareExtensions(const FileSystemItem *i, const FileSystemItem *j) const
+{
+    return strcmp(stringKey(i->getExtension()), stringKey(j->getExtension()));
+}
+
+int SortModel::compareSizes(const FileSystemItem *i, const FileSystemItem *j) const
+{
+    quint64 left = i->getSize();
+    quint64 right = j->getSize();
+    return (left < right) ? -1 : ((left > right) ? 1 : 0);
+}
+
+int SortModel::compareTypes(const FileSystemItem *i, const FileSystemItem *j) const
+{
+    return strcmp(stringKey(i->getType()), stringKey(j->getType()));
+}
+
+int SortModel::compareLastChangeTimes(const FileSystemItem *i, const FileSystemItem *j) const
+{
+    // Unknown times are the lowest value, like invalid dates
+    qint64 left = i->getLastChangeTimeNSecs();
+    qint64 right = j->getLastChangeTimeNSecs();
+    return (left < right) ? -1 : ((left > right) ? 1 : 0);
+}
+
+/*!
+ * \brief Returns the collation key of \a string, which is kept since the same extensions and types repeat a lot.
+ */
+const char *SortModel::stringKey(const QString &string) const
+{
+    if (stringKeysGeneration != Collation::generation()) {
+        stringKeys.clear();
+        stringKeysGeneration = Collation::generation();
+    }
+
+    auto key = stringKeys.constFind(string);
+    if (key == stringKeys.cend())
+        key = stringKeys.insert(string, Collation::sortKey(string));
+
+    return key.value().constData();
+}
+
+/*!
+ * \brief Ranks all the children of \a parent by the current sort column and order.
+ * \param parentIndex the index of \a parent in the source model.
+ *
+ * The children are sorted with the same rules as lessThan(), splitting them between all the cores and merging the
+ * sorted parts, so QSortFilterProxyModel only has to compare integers and moves the rows in a single layout change.
+ */
+const SortModel::Ranking *SortModel::rank(const QModelIndex &parentIndex, FileSystemItem *parent) const
+{
+    QTime start;
+    start.start();
+
     int column = sortColumn();
-    QVariant left  = i->getData(column);
-    QVariant right = j->getData(column);
+    int count = parent->childrenCount();
 
-    if (static_cast<QMetaType::Type>(left.type()) == QMetaType::QString) {
+    // Make every key now, so the threads below only read them
+    QVector<const FileSystemItem *> children(count);
+    for (int row = 0; row < count; row++) {
+        const FileSystemItem *child = parent->getChildAt(row);
+        children[row] = child;
 
-        QString strLeft = left.toString();
-        QString strRight = right.toString();
+        child->getSortKey();
+        if (column == FileSystemModel::Extension)
+            stringKey(child->getExtension());
+        else if (column == FileSystemModel::Type)
+            stringKey(child->getType());
+    }
 
-        comparison = (coll->compare(reinterpret_cast<const char16_t *>(strLeft.utf16()), strLeft.length(),
-                                    reinterpret_cast<const char16_t *>(strRight.utf16()), strRight.length()) < 0);
-    } else
-        comparison = (left < right);
+    auto less = [this, &children](int left, int right) {
+        return (sortOrder() == Qt::AscendingOrder) ? lessThan(children.at(left), children.at(right)) :
+                                                     lessThan(children.at(right), children.at(left));
+    };
 
-    // If both items are files or both are folders then direct comparison is allowed
-    if ((!i->isFolder() && !j->isFolder()) || (i->isFolder() && j->isFolder())) {
-        if (left == right) {
-            comparison = (coll->compare(reinterpret_cast<const char16_t *>(i->getDisplayName().utf16()), i->getDisplayName().length(),
-                                        reinterpret_cast<const char16_t *>(j->getDisplayName().utf16()), j->getDisplayName().length()) < 0);
+    QVector<int> rows(count);
+    std::iota(rows.begin(), rows.end(), 0);
+
+    int threads = qMax(1, QThread::idealThreadCount());
+    int width = (count + threads - 1) / threads;
+
+    // Sort the parts
+    QList<QFuture<void>> futures;
+    for (int begin = 0; begin < count; begin += width) {
+        int end = qMin(begin + width, count);
+        futures.append(QtConcurrent::run([&rows, &less, begin, end]() {
+            std::stable_sort(rows.begin() + begin, rows.begin() + end, less);
+        }));
+    }
+
+    for (QFuture<void> &future : futures)
+        future.waitForFinished();
+
+    // And merge them in pairs, which keeps the sort stable
+    QVector<int> merged(count);
+    for (; width < count; width *= 2) {
+
+        futures.clear();
+        for (int begin = 0; begin < count; begin += 2 * width) {
+            int middle = qMin(begin + width, count);
+            int end = qMin(begin + 2 * width, count);
+            futures.append(QtConcurrent::run([&rows, &merged, &less, begin, middle, end]() {
+                std::merge(rows.cbegin() + begin, rows.cbegin() + middle, rows.cbegin() + middle, rows.cbegin() + end,
+                           merged.begin() + begin, less);
+            }));
         }
 
-        return comparison;
+        for (QFuture<void> &future : futures)
+            future.waitForFinished();
+
+        rows.swap(merged);
     }
 
-    return false;
+    Ranking &ranking = rankings[parent];
+    ranking.parent = parentIndex;
+    ranking.column = column;
+    ranking.order = sortOrder();
+    ranking.ranks.resize(count);
+    for (int position = 0; position < count; position++)
+        ranking.ranks[rows.at(position)] = position;
+
+    qDebug() << "SortModel::rank" << count << "children ranked in" << start.elapsed() << "milliseconds";
+
+    return &ranking;
+}
+
+/*!
+ * \brief Returns the ranking of the children of \a parent for the current sort, or nullptr if there's none.
+ */
+const SortModel::Ranking *SortModel::findRanking(FileSystemItem *parent) const
+{
+    auto ranking = rankings.constFind(parent);
+    if (ranking == rankings.cend())
+        return nullptr;
+
+    // The item might be a new one at the address of a removed folder
+    if (!ranking->parent.isValid() || ranking->parent.internalPointer() != parent ||
+            ranking->ranks.size() != parent->childrenCount() ||
+            ranking->column != sortColumn() || ranking->order != sortOrder())
+        return nullptr;
+
+    return &ranking.value();
+}
+
+/*!
+ * \brief Ranks the rows from \a first to \a last just inserted in \a parent among the rows already ranked.
+ *
+ * Adding k files to a folder of n costs O(k log n) comparisons instead of ranking it again. \sa Ranks::insert
+ */
+void SortModel::insertRanks(const QModelIndex &parent, int first, int last)
+{
+    if (!parent.isValid())
+        return;
+
+    FileSystemItem *parentItem = reinterpret_cast<FileSystemItem *>(parent.internalPointer());
+    auto ranking = rankings.find(parentItem);
+    if (ranking == rankings.end())
+        return;
+
+    int count = last - first + 1;
+    int total = ranking->ranks.size() + count;
+    if (ranking->column != sortColumn() || ranking->order != sortOrder() || total != parentItem->childrenCount()) {
+        rankings.erase(ranking);
+        return;
+    }
+
+    auto less = [this, parentItem](int left, int right) {
+        return (sortOrder() == Qt::AscendingOrder) ? lessThan(parentItem->getChildAt(left), parentItem->getChildAt(right)) :
+                                                     lessThan(parentItem->getChildAt(right), parentItem->getChildAt(left));
+    };
+
+    Ranks::insert(ranking->ranks, first, count, less);
+}
+
+/*!
+ * \brief Removes the rows from \a first to \a last just removed from \a parent from its ranking.
+ *
+ * The rest keep their order, they're only numbered again. \sa Ranks::remove
+ */
+void SortModel::removeRanks(const QModelIndex &parent, int first, int last)
+{
+    if (!parent.isValid())
+        return;
+
+    FileSystemItem *parentItem = reinterpret_cast<FileSystemItem *>(parent.internalPointer());
+    auto ranking = rankings.find(parentItem);
+    if (ranking == rankings.end())
+        return;
+
+    int count = last - first + 1;
+    int total = ranking->ranks.size() - count;
+    if (total != parentItem->childrenCount()) {
+        rankings.erase(ranking);
+        return;
+    }
+
+    Ranks::remove(ranking->ranks, first, last);
+}
+
+void SortModel::dropRanking(const QModelIndex &parent)
+{
+    if (parent.isValid())
+        rankings.remove(reinterpret_cast<FileSystemItem *>(parent.internalPointer()));
 }
 
 Qt::DropAction SortModel::defaultDropActionForIndex(QModelIndex index, const QMimeData *data, Qt::DropActions possibleActions)
 {
-    FileSystemModel *model = reinterpret_cast<FileSystemModel *>(sourceModel());
-    return model->defaultDropActionForIndex(mapToSource(index), data, possibleActions);
+    return getFileSystemModel()->defaultDropActionForIndex(mapToFileSystemModel(index), data, possibleActions);
 }
@@ -1,25 +1,86 @@
 #ifndef SORTMODEL_H
 #define SORTMODEL_H
 
-#include <unicode/coll.h>
-
 #include <QSortFilterProxyModel>
+#include <QPersistentModelIndex>
+#include <QByteArray>
+#include <QVector>
+#include <QHash>
+
+#include "Model/NameFilter.h"
+
+class FileSystemItem;
+class FileSystemModel;
+class QTimer;
 
 class SortModel : public QSortFilterProxyModel
 {
 public:
     SortModel(QObject *parent = nullptr);
-    ~SortModel();
 
     bool willRecycle(const QModelIndex &index);
     void removeIndexes(QModelIndexList indexList, bool permanent);
     Qt::DropAction defaultDropActionForIndex(QModelIndex index, const QMimeData *data, Qt::DropActions possibleActions);
 
+    void setSourceModel(QAbstractItemModel *sourceModel) override;
+    void resort();
+    void setNameFilter(const QModelIndex &parent, const QString &text);
+
+    virtual FileSystemModel *getFileSystemModel() const;
+    virtual QModelIndex mapToFileSystemModel(const QModelIndex &proxyIndex) const;
+    virtual QModelIndex mapFromFileSystemModel(const QModelIndex &modelIndex) const;
+
 protected:
+    void setParallelSortThreshold(int value);
+
     bool lessThan(const QModelIndex &source_left, const QModelIndex &source_right) const override;
+    bool filterAcceptsRow(int source_row, const QModelIndex &source_parent) const override;
 
 private:
-    icu::Collator *coll {};
+    // The positions of the children of a folder once sorted, indexed by their source rows
+    struct Ranking {
+        QPersistentModelIndex parent;
+        int column                  {};
+        Qt::SortOrder order         {};
+        QVector<int> ranks;
+    };
+
+    mutable QHash<const FileSystemItem *, Ranking> rankings;
+    int parallelSortThreshold   {};
+    bool updating               {};     // Rows are being inserted or changed one by one
+
+    QTimer *resortTimer         {};
+    bool resortPending          {};     // Changed rows were left in place until the timer fires
+
+    void deferResort(const QVector<int> &roles);
+
+    // Only the children of this folder are filtered, the one the view shows
+    QPersistentModelIndex filterParent  {};
+    mutable NameFilter nameFilter       {};
+
+    void invalidateNameFilter(const QModelIndex &parent);
+
+    bool lessThan(const FileSystemItem *i, const FileSystemItem *j) const;
+    const Ranking *rank(const QModelIndex &parentIndex, FileSystemItem *parent) const;
+    const Ranking *findRanking(FileSystemItem *parent) const;
+    void insertRanks(const QModelIndex &parent, int first, int last);
+    void removeRanks(const QModelIndex &parent, int first, int last);
+    void dropRanking(const QModelIndex &parent);
+
+    typedef int (SortModel::*Comparator)(const FileSystemItem *i, const FileSystemItem *j) const;
+    static const Comparator comparators[];
+
+    int compareNames(const FileSystemItem *i, const FileSystemItem *j) const;
+    int compareExtensions(const FileSystemItem *i, const FileSystemItem *j) const;
+    int compareSizes(const FileSystemItem *i, const FileSystemItem *j) const;
+    int compareTypes(const FileSystemItem *i, const FileSystemItem *j) const;
+    int compareLastChangeTimes(const FileSystemItem *i, const FileSystemItem *j) const;
+
+    // Collation keys of the extensions and types, there are only a few different ones
+    mutable QHash<QString, QByteArray> stringKeys;
+    mutable quint32 stringKeysGeneration {};
+
+    const char *stringKey(const QString &string) const;
 };
 
 #endif // SORTMODEL_H
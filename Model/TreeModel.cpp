@@ -3,25 +3,12 @@
 #include "TreeModel.h"
 
 #include "Model/FileSystemModel.h"
+#include "Model/FolderModel.h"
 
 TreeModel::TreeModel(QObject *parent) : SortModel(parent)
 {
-}
-
-bool TreeModel::filterAcceptsRow(int source_row, const QModelIndex &source_parent) const
-{
-    if (source_parent.isValid()) {
-
-        if (!(source_parent.data(FileSystemModel::AllChildrenFetchedRole).toBool()))
-            return false;
-
-        QModelIndex source = source_parent.model()->index(source_row, 0, source_parent);
-
-        if (source.isValid())
-            return source.data(FileSystemModel::DriveRole).toBool() || source.data(FileSystemModel::FolderRole).toBool() || !source.parent().isValid();
-    }
-
-    return true;
+    // The rows of the source are the folders of a folder, which are few, and not the rows of all its children
+    setParallelSortThreshold(0);
 }
 
 bool TreeModel::filterAcceptsColumn(int source_column, const QModelIndex &source_parent) const
@@ -33,8 +20,15 @@ bool TreeModel::filterAcceptsColumn(int source_column, const QModelIndex &source
 bool TreeModel::hasChildren(const QModelIndex &parent) const
 {
     QModelIndex source = mapToSource(parent);
-    if (source.isValid())
-        return source.data(FileSystemModel::HasSubFoldersRole).toBool();
+    if (source.isValid()) {
+        FileSystemItem *item = reinterpret_cast<FileSystemItem *>(source.internalPointer());
+
+        // Once the children are known, the folders among them say it without waiting for the retriever
+        if (item->areAllChildrenFetched())
+            return item->foldersCount() > 0;
+
+        return item->getHasSubFolders();
+    }
 
     return true;
 }
@@ -42,8 +36,10 @@ bool TreeModel::hasChildren(const QModelIndex &parent) const
 bool TreeModel::canFetchMore(const QModelIndex &parent) const
 {
     QModelIndex source = mapToSource(parent);
-    if (source.isValid())
-        return source.data(FileSystemModel::HasSubFoldersRole).toBool() && !(source.data(FileSystemModel::AllChildrenFetchedRole).toBool());
+    if (source.isValid()) {
+        FileSystemItem *item = reinterpret_cast<FileSystemItem *>(source.internalPointer());
+        return item->getHasSubFolders() && !item->areAllChildrenFetched();
+    }
 
     return false;
 }
@@ -57,3 +53,22 @@ QVariant TreeModel::data(const QModelIndex &index, int role) const
     return SortModel::data(index, role);
 }
 
+FileSystemModel *TreeModel::getFileSystemModel() const
+{
+    return reinterpret_cast<FolderModel *>(sourceModel())->getFileSystemModel();
+}
+
+QModelIndex TreeModel::mapToFileSystemModel(const QModelIndex &proxyIndex) const
+{
+    FolderModel *folderModel = reinterpret_cast<FolderModel *>(sourceModel());
+    return folderModel->mapToSource(mapToSource(proxyIndex));
+}
+
+/*!
+ * \brief Returns the index of this model that corresponds to \a modelIndex, or an invalid index if it's a file.
+ */
+QModelIndex TreeModel::mapFromFileSystemModel(const QModelIndex &modelIndex) const
+{
+    FolderModel *folderModel = reinterpret_cast<FolderModel *>(sourceModel());
+    return mapFromSource(folderModel->mapFromSource(modelIndex));
+}
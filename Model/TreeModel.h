@@ -3,6 +3,13 @@
 
 #include "Model/SortModel.h"
 
+/*!
+ * \brief The model of the trees, the folders of the FileSystemModel sorted.
+ *
+ * Its source is the FolderModel shared by all the trees, so only the folders are sorted and filtered here.  The rest
+ * of the application uses indexes of the FileSystemModel, that are mapped through both models.
+ * \sa mapToFileSystemModel \sa mapFromFileSystemModel
+ */
 class TreeModel : public SortModel
 {
 public:
@@ -12,8 +19,11 @@ public:
     bool canFetchMore(const QModelIndex &parent) const override;
     QVariant data(const QModelIndex &index, int role) const override;
 
+    FileSystemModel *getFileSystemModel() const override;
+    QModelIndex mapToFileSystemModel(const QModelIndex &proxyIndex) const override;
+    QModelIndex mapFromFileSystemModel(const QModelIndex &modelIndex) const override;
+
 protected:
-    bool filterAcceptsRow(int source_row, const QModelIndex &source_parent) const override;
     virtual bool filterAcceptsColumn(int source_column, const QModelIndex &source_parent) const override;
 };
 
@@ -183,6 +183,7 @@ void  Settings::createDefaultSettings()
 void Settings::createGlobalDefaultSettings()
 {
     global.insert(SETTINGS_GLOBAL_EXPLORERS, 2);
+    global.insert(SETTINGS_GLOBAL_PARALLEL_SORT_THRESHOLD, 20000);
     global.insert(SETTINGS_GLOBAL_X, -1);
     global.insert(SETTINGS_GLOBAL_Y, -1);
     global.insert(SETTINGS_GLOBAL_WIDTH, -1);
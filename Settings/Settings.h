@@ -18,6 +18,7 @@
 #define SETTINGS_GLOBAL_SCREEN              "screen"
 #define SETTINGS_GLOBAL_SPLITTER_SIZES      "splittersizes"
 #define SETTINGS_GLOBAL_EXPLORERS           "explorers"
+#define SETTINGS_GLOBAL_PARALLEL_SORT_THRESHOLD "parallelsortthreshold"
 
 // Panes settings
 #define SETTINGS_PANES                      "panes"
@@ -0,0 +1,127 @@
+#ifndef BOUNDEDQUEUE_H
+#define BOUNDEDQUEUE_H
+
+#include <QtGlobal>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+/*!
+ * \brief A bounded lock-free multi-producer multi-consumer queue.
+ *
+ * Any number of threads can push and pop at the same time without taking a lock.  Every slot of the ring buffer
+ * has a sequence number that tells if it's ready to be written or read, so producers and consumers only contend
+ * on a single atomic position each.
+ *
+ * push() fails instead of blocking when the queue is full, so the caller can fall back to another path.
+ *
+ * The capacity is rounded up to a power of two.
+ */
+template <typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(int capacity)
+    {
+        size_t size = 2;
+        while (size < static_cast<size_t>(capacity))
+            size <<= 1;
+
+        mask = size - 1;
+        cells = new Cell[size];
+
+        for (size_t i = 0; i < size; i++)
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    ~BoundedQueue()
+    {
+        delete[] cells;
+    }
+
+    /*!
+     * \brief Appends \a value to the queue.
+     * \return false if the queue is full.
+     */
+    bool push(T value)
+    {
+        size_t position = enqueuePosition.load(std::memory_order_relaxed);
+        Cell *cell;
+
+        forever {
+            cell = &cells[position & mask];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+
+            if (difference == 0) {
+                if (enqueuePosition.compare_exchange_weak(position, position + 1))
+                    break;
+            } else if (difference < 0)
+                return false;
+            else
+                position = enqueuePosition.load(std::memory_order_relaxed);
+        }
+
+        cell->data = std::move(value);
+        cell->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    /*!
+     * \brief Takes the first value of the queue.
+     * \return false if the queue is empty.
+     */
+    bool pop(T &value)
+    {
+        size_t position = dequeuePosition.load(std::memory_order_relaxed);
+        Cell *cell;
+
+        forever {
+            cell = &cells[position & mask];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1);
+
+            if (difference == 0) {
+                if (dequeuePosition.compare_exchange_weak(position, position + 1))
+                    break;
+            } else if (difference < 0)
+                return false;
+            else
+                position = dequeuePosition.load(std::memory_order_relaxed);
+        }
+
+        value = std::move(cell->data);
+        cell->data = T();
+        cell->sequence.store(position + mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    /*!
+     * \brief Returns true if nothing was pushed that hasn't been popped yet.
+     *
+     * A value being pushed right now already counts, even if pop() can't take it yet.
+     */
+    bool isEmpty() const
+    {
+        return enqueuePosition.load() == dequeuePosition.load();
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T                   data;
+    };
+
+    Cell               *cells           {};
+    size_t              mask            {};
+
+    // Each position is in its own cache line, so producers and consumers don't slow each other down
+    alignas(64) std::atomic<size_t> enqueuePosition { 0 };
+    alignas(64) std::atomic<size_t> dequeuePosition { 0 };
+
+    Q_DISABLE_COPY(BoundedQueue)
+};
+
+#endif // BOUNDEDQUEUE_H
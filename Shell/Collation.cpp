@@ -0,0 +1,161 @@
+#include <QLocale>
+#include <QDebug>
+
+#include <unicode/coll.h>
+
+#include <atomic>
+#include <cstring>
+#include <memory>
+
+#include "Collation.h"
+
+// Most keys fit in this, longer ones take a second pass
+#define SORT_KEY_BUFFER_SIZE        256
+
+namespace {
+
+// Increased every time the locale changes, so every collator and key made before is made again
+std::atomic<quint32> currentGeneration { 1 };
+
+struct ThreadCollator {
+    std::unique_ptr<icu::Collator> collator;
+    quint32 generation {};
+};
+
+/*!
+ * \brief Returns the collator of this thread for the current locale, or nullptr if ICU couldn't make one.
+ * \param generation the generation of the collation is stored here.
+ */
+icu::Collator *collator(quint32 &generation)
+{
+    thread_local ThreadCollator threadCollator;
+
+    generation = currentGeneration.load();
+
+    if (threadCollator.generation != generation) {
+        UErrorCode status = U_ZERO_ERROR;
+        icu::Locale locale(QLocale().name().toLatin1().constData());
+        threadCollator.collator.reset(icu::Collator::createInstance(locale, status));
+
+        if (U_FAILURE(status)) {
+            qDebug() << "Collation::collator cannot create a collator for" << QLocale().name() << u_errorName(status);
+            threadCollator.collator.reset();
+        } else
+            threadCollator.collator->setAttribute(UCOL_NUMERIC_COLLATION, UCOL_ON, status);
+
+        threadCollator.generation = generation;
+    }
+
+    return threadCollator.collator.get();
+}
+
+/*!
+ * \brief Writes the key of \a string after \a headerSize bytes of a new buffer.
+ * \return the buffer, to be freed with delete[].  The key is always terminated by a zero.
+ */
+char *makeKey(const QString &string, int headerSize, quint32 &generation, int &length)
+{
+    icu::Collator *coll = collator(generation);
+
+    if (coll == nullptr) {
+        QByteArray utf8 = string.toUtf8();
+        length = utf8.size() + 1;
+        char *buffer = new char[headerSize + length];
+        memcpy(buffer + headerSize, utf8.constData(), static_cast<size_t>(length));
+        return buffer;
+    }
+
+    const char16_t *source = reinterpret_cast<const char16_t *>(string.utf16());
+    uint8_t stackBuffer[SORT_KEY_BUFFER_SIZE];
+
+    length = coll->getSortKey(source, string.length(), stackBuffer, SORT_KEY_BUFFER_SIZE);
+
+    char *buffer = new char[headerSize + length];
+    if (length <= SORT_KEY_BUFFER_SIZE)
+        memcpy(buffer + headerSize, stackBuffer, static_cast<size_t>(length));
+    else
+        coll->getSortKey(source, string.length(), reinterpret_cast<uint8_t *>(buffer + headerSize), length);
+
+    return buffer;
+}
+
+}
+
+/*!
+ * \brief Returns the collation key of \a string.
+ */
+QByteArray Collation::sortKey(const QString &string)
+{
+    quint32 generation;
+    int length;
+    char *buffer = makeKey(string, 0, generation, length);
+
+    // The terminating zero is not part of the QByteArray
+    QByteArray key(buffer, length - 1);
+    delete[] buffer;
+
+    return key;
+}
+
+/*!
+ * \brief Compares \a left and \a right without making their keys.
+ * \return a negative number, zero or a positive number if \a left sorts before, like or after \a right.
+ */
+int Collation::compare(const QString &left, const QString &right)
+{
+    quint32 generation;
+    icu::Collator *coll = collator(generation);
+
+    if (coll == nullptr)
+        return left.compare(right);
+
+    return coll->compare(reinterpret_cast<const char16_t *>(left.utf16()), left.length(),
+                         reinterpret_cast<const char16_t *>(right.utf16()), right.length());
+}
+
+/*!
+ * \brief Returns a new key of \a string stamped with the generation of the collation.
+ *
+ * The key must be freed with delete[].
+ */
+char *Collation::newStampedKey(const QString &string)
+{
+    quint32 generation;
+    int length;
+    char *buffer = makeKey(string, sizeof(quint32), generation, length);
+    memcpy(buffer, &generation, sizeof(quint32));
+
+    return buffer;
+}
+
+/*!
+ * \brief Returns true if \a stampedKey was made with the collation of the current locale.
+ */
+bool Collation::isCurrent(const char *stampedKey)
+{
+    quint32 generation;
+    memcpy(&generation, stampedKey, sizeof(quint32));
+
+    return generation == currentGeneration.load();
+}
+
+/*!
+ * \brief Returns the key in \a stampedKey, to be compared with strcmp().
+ */
+const char *Collation::keyOf(const char *stampedKey)
+{
+    return stampedKey + sizeof(quint32);
+}
+
+quint32 Collation::generation()
+{
+    return currentGeneration.load();
+}
+
+/*!
+ * \brief Makes every thread use a collator of the current locale, and every key made before stale.
+ */
+void Collation::localeChanged()
+{
+    currentGeneration++;
+}
@@ -0,0 +1,32 @@
+#ifndef COLLATION_H
+#define COLLATION_H
+
+#include <QByteArray>
+#include <QString>
+
+/*!
+ * \brief Locale aware comparison of names through ICU collation keys.
+ *
+ * Comparing two strings with a collator is expensive, so names are turned into collation keys once and then compared
+ * with strcmp(), which gives the same order.  Numbers inside the names are compared by their values.
+ *
+ * Every thread has its own collator, so keys can be made in the retriever threads while the GUI thread sorts.
+ *
+ * Stamped keys carry the generation of the collation they were made with, so they can be kept with the items and
+ * made again after the locale changes. \sa localeChanged
+ */
+class Collation
+{
+public:
+    static QByteArray sortKey(const QString &string);
+    static int compare(const QString &left, const QString &right);
+
+    static char *newStampedKey(const QString &string);
+    static bool isCurrent(const char *stampedKey);
+    static const char *keyOf(const char *stampedKey);
+
+    static quint32 generation();
+    static void localeChanged();
+};
+
+#endif // COLLATION_H
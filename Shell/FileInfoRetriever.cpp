@@ -1,17 +1,77 @@
 #include <QtConcurrent/QtConcurrentRun>
 #include <QApplication>
 #include <QModelIndex>
+#include <QThread>
 #include <QTimer>
 #include <QDebug>
 
 #include "FileInfoRetriever.h"
 
+// When streaming, children are published every CHILDREN_BATCH_SIZE items or every CHILDREN_BATCH_MSECS milliseconds
+#define CHILDREN_BATCH_SIZE     1000
+#define CHILDREN_BATCH_MSECS    50
+
+// The metadata of the children of a folder is retrieved in chunks of METADATA_CHUNK_SIZE items
+#define METADATA_CHUNK_SIZE     256
+
+// Default number of worker threads for every class of jobs
+#define LISTING_WORKERS         2
+#define ICON_WORKERS            2
+#define METADATA_WORKERS        2
+
+// A job waiting for more than AGING_MSECS milliseconds is promoted to the next higher priority, up to Visible
+#define AGING_MSECS             2000
+
+// Number of new jobs that can wait to be moved to the priority queues.  When it's full new jobs take the slow path
+#define INBOX_SIZE              4096
+
 #ifdef Q_OS_WIN
 QMutex FileInfoRetriever::threadMutex;
 #endif
 
-FileInfoRetriever::FileInfoRetriever(QObject *parent) : QThread(parent)
+thread_local FileInfoRetriever::Worker *FileInfoRetriever::currentWorker {};
+
+/*!
+ * \brief A worker thread of a FileInfoRetriever.
+ *
+ * Every worker only runs jobs of its own JobClass.  All the state of the job being run lives here, so several
+ * workers can run jobs at the same time.
+ */
+class FileInfoRetriever::Worker : public QThread
+{
+public:
+    Worker(FileInfoRetriever *retriever, JobClass jobClass) : retriever(retriever), jobClass(jobClass) {}
+
+    FileInfoRetriever  *retriever;
+    JobClass            jobClass;
+
+    // Guarded by FileInfoRetriever::jobMutex.  The item is nullptr while the worker is idle
+    Job                 currentJob  {};
+
+    // Items to delete when the current job is done.  Guarded by FileInfoRetriever::jobMutex \sa purgeJobs
+    QList<QSharedPointer<Removal>> removals;
+
+    // Children found but not published yet \sa FileInfoRetriever::addChild
+    QList<FileSystemItem *> pendingChildren;
+    QElapsedTimer       batchTimer;
+
+    // Storage of the children of the folder being listed \sa FileInfoRetriever::newChild
+    FileSystemItemArena *arena  {};
+
+protected:
+    void run() override
+    {
+        retriever->runWorker(this);
+    }
+};
+
+FileInfoRetriever::FileInfoRetriever(QObject *parent) : QObject(parent), inbox(INBOX_SIZE)
 {
+    workers[ListingJobs] = LISTING_WORKERS;
+    workers[IconJobs] = ICON_WORKERS;
+    workers[MetadataJobs] = METADATA_WORKERS;
+
+    clock.start();
 }
 
 FileInfoRetriever::~FileInfoRetriever()
@@ -20,12 +80,6 @@ FileInfoRetriever::~FileInfoRetriever()
 
     quit();
 
-    if (running.load()) {
-
-        // Abort all the pending threads
-        running.store(false);
-    }
-
     qDebug() << "FileInfoRetriever::~FileInfoRetriever Destroyed";
 }
 
@@ -34,131 +88,858 @@ QString FileInfoRetriever::getRootPath() const
     return "/";
 }
 
+bool FileInfoRetriever::isStreaming() const
+{
+    return streaming;
+}
+
+/*!
+ * \brief Sets the streaming mode of this retriever.
+ * \param value true to enable streaming.
+ *
+ * In streaming mode the children of a folder are not added to the folder by the background thread.  Instead they are
+ * published in small batches with the parentChildrenAdded signal while the folder is still being read, and the receiver
+ * is responsible for adding them to the parent.  This way a view can show the first rows of a huge folder right away.
+ *
+ * When streaming is disabled (the default) the children are added to the parent directly and only parentChildrenUpdated
+ * is emitted at the end.
+ */
+void FileInfoRetriever::setStreaming(bool value)
+{
+    streaming = value;
+}
+
+/*!
+ * \brief Returns true if the children of a folder are published before their size and dates are known.
+ *
+ * Their metadata is retrieved afterwards by a Metadata job, and parentMetadataUpdated is emitted when it's complete.
+ * Otherwise the listing already includes it.  This implementation returns false.  \sa getMetadata
+ */
+bool FileInfoRetriever::isMetadataDeferred() const
+{
+    return false;
+}
+
+bool FileInfoRetriever::isUsingArenas() const
+{
+    return usingArenas;
+}
+
+/*!
+ * \brief Sets whether the children of every listing are allocated together from a FileSystemItemArena.
+ * \param value false to allocate every child alone.
+ *
+ * Arenas are enabled by default.  A retriever whose listings are thrown away after a few of their children are moved
+ * somewhere else should disable them, since those children would keep the whole arena of their listing alive.
+ */
+void FileInfoRetriever::setUsingArenas(bool value)
+{
+    usingArenas = value;
+}
+
+int FileInfoRetriever::workerCount(JobClass jobClass) const
+{
+    return workers[jobClass];
+}
+
+/*!
+ * \brief Sets the number of worker threads that run jobs of class \a jobClass.
+ * \param jobClass a JobClass.
+ * \param count the number of workers.  With 0 workers jobs of this class are queued but never run.
+ *
+ * This function must be called before start().
+ */
+void FileInfoRetriever::setWorkerCount(JobClass jobClass, int count)
+{
+    workers[jobClass] = qMax(0, count);
+}
+
+/*!
+ * \brief Starts all the worker threads.
+ *
+ * Jobs can be queued before this function is called.  They will be run as soon as the workers start.
+ */
+void FileInfoRetriever::start()
+{
+    if (!workerThreads.isEmpty())
+        return;
+
+    threadRunning.store(true);
+
+    for (int jobClass = 0; jobClass < JobClassCount; jobClass++) {
+        for (int i = 0; i < workers[jobClass]; i++) {
+            Worker *worker = new Worker(this, static_cast<JobClass>(jobClass));
+            workerThreads.append(worker);
+            worker->start();
+        }
+    }
+}
+
+/*!
+ * \brief Returns false if the job running in the current thread has been aborted.
+ *
+ * Implementations must check this function regularly during long jobs, like the enumeration of a folder.
+ * It always returns true outside the worker threads.
+ *
+ * \sa cancelJobs
+ */
+bool FileInfoRetriever::isRunning() const
+{
+    return currentWorker == nullptr || (threadRunning.load() && !currentWorker->currentJob.token->cancelled.load());
+}
+
 void FileInfoRetriever::getInfo(FileSystemItem *parent)
 {
-    addJob(parent, Parent);
+    addJob(parent, Parent, Foreground);
+}
+
+FileInfoRetriever::JobClass FileInfoRetriever::jobClass(JobType type)
+{
+    switch (type) {
+        case Parent:
+        case Children:
+            return ListingJobs;
+        case Icon:
+            return IconJobs;
+        default:
+            return MetadataJobs;
+    }
 }
 
-void FileInfoRetriever::addJob(FileSystemItem *item, FileInfoRetriever::JobType type, bool insertAtFront)
+void FileInfoRetriever::addJob(FileSystemItem *item, FileInfoRetriever::JobType type, Priority priority, bool insertAtFront)
 {
     Job job;
     job.item = item;
     job.type = type;
-    if (!insertAtFront)
-        jobsQueue.append(job);
-    else
-        jobsQueue.insert(0, job);
+    job.priority = priority;
+    job.offset = 0;
+    addJob(job, insertAtFront);
+}
+
+/*!
+ * \brief Queues \a job.  It can be called from any thread, and jobMutex must not be locked.
+ * \param job a Job.
+ * \param insertAtFront true if the job should run before the other jobs with the same priority.
+ *
+ * Every job belongs to a folder: the folder itself for Parent, Children and Metadata jobs, and the parent of the item
+ * for the rest.  Cancelling the jobs of a folder cancels all of them.  \sa cancelJobs
+ *
+ * The job is pushed to a lock-free inbox, so queueing thousands of icons while a view scrolls doesn't contend with the
+ * workers.  A sleeping worker is only woken up if there's one and nobody else woke it up already.
+ */
+void FileInfoRetriever::addJob(Job job, bool insertAtFront)
+{
+    if (job.token.isNull()) {
+        switch (job.type) {
+            case Parent:
+            case Children:
+            case Metadata:
+                job.owner = job.item;
+                break;
+            default:
+                job.owner = job.item->getParent() != nullptr ? job.item->getParent() : job.item;
+        }
+    }
 
-    jobAvailable.wakeAll();
+    job.queuedAt = clock.elapsed();
+    job.insertAtFront = insertAtFront;
+
+    if (!inbox.push(job)) {
+        QMutexLocker locker(&jobMutex);
+        queueJob(job);
+        jobAvailable[jobClass(job.type)].wakeOne();
+        return;
+    }
+
+    wakeWorker(jobClass(job.type));
 }
 
-void FileInfoRetriever::run()
+void FileInfoRetriever::wakeWorker(JobClass jobClass)
 {
-    QMutex mutex;
+    if (idleWorkers[jobClass].load() > 0 && !wakePending[jobClass].exchange(true)) {
+        QMutexLocker locker(&jobMutex);
+        jobAvailable[jobClass].wakeOne();
+    }
+}
 
-    threadRunning.store(true);
+/*!
+ * \brief Moves all the jobs of the inbox to the priority queues.  jobMutex must be locked.
+ */
+void FileInfoRetriever::drainJobs()
+{
+    Job job;
+    while (inbox.pop(job))
+        queueJob(job);
+}
 
-    forever {
+/*!
+ * \brief Puts \a job in its priority queue.  jobMutex must be locked.
+ * \param job a Job.
+ *
+ * A new job gets the token of its folder, so cancelling the folder cancels it too.
+ *
+ * If the same item already has a job of the same type queued, \a job is dropped.  If the queued one has a lower
+ * priority, \a job takes its place in queuedJobs and the old one is dropped when it's taken, so merging a request
+ * takes constant time.  Metadata jobs are never merged, since each one carries its own list of children.
+ */
+void FileInfoRetriever::queueJob(Job job)
+{
+    if (job.token.isNull()) {
+        Token &token = ownerTokens[job.owner];
+        if (token.isNull())
+            token = Token(new JobState());
+        job.token = token;
+    }
 
-        if (!threadRunning.load())
-            break;
+    if (job.token->cancelled.load())
+        return;
 
-        mutex.lock();
+    job.serial = ++lastSerial;
 
-        if (jobsQueue.isEmpty())
-            jobAvailable.wait(&mutex);
+    if (job.type != Metadata) {
 
-        if (!threadRunning.load()) {
-            mutex.unlock();
-            break;
+        QPair<FileSystemItem *, int> key(job.item, job.type);
+        auto it = queuedJobs.find(key);
+
+        // A cancelled job stays in its queue until it's taken, but it doesn't count
+        if (it != queuedJobs.end() && !it->token->cancelled.load()) {
+
+            if (job.priority >= it->priority)
+                return;
         }
 
-        if (!jobsQueue.isEmpty()) {
+        queuedJobs.insert(key, QueuedJob { job.priority, job.serial, job.token });
+    }
+
+    if (!job.insertAtFront)
+        jobsQueue[jobClass(job.type)][job.priority].enqueue(job);
+    else
+        jobsQueue[jobClass(job.type)][job.priority].prepend(job);
+}
 
-            running.store(true);
-            jobMutex.lock();
-            currentJob = jobsQueue.takeFirst();
-            jobMutex.unlock();
+/*!
+ * \brief Takes the first job of \a queue.  jobMutex must be locked.
+ * \param queue a queue of jobsQueue.
+ * \param job the job taken.
+ * \return false if the job was cancelled or removed while it was queued, and it must be dropped.
+ */
+bool FileInfoRetriever::dequeueJob(QQueue<Job> &queue, Job &job)
+{
+    job = queue.dequeue();
 
-            if (currentJob.item != nullptr) {
+    if (job.type != Metadata) {
 
-#ifdef Q_OS_WIN
-                threadMutex.lock();
-#endif
+        // Removed while it was queued, or merged into a job with a higher priority \sa purgeJobs
+        auto it = queuedJobs.find(qMakePair(job.item, static_cast<int>(job.type)));
+        if (it == queuedJobs.end() || it->serial != job.serial)
+            return false;
 
-                switch(currentJob.type) {
+        queuedJobs.erase(it);
+    }
 
-                    case Parent:
-                        getParentBackground(currentJob.item);
-                        break;
-                    case Children:
-                        if (!currentJob.item->areAllChildrenFetched())
-                            getChildrenBackground(currentJob.item);
-                        break;
-                    case Icon:
-                        getIconBackground(currentJob.item);
-                        break;
-                }
+    return !job.token->cancelled.load();
+}
 
-#ifdef Q_OS_WIN
-                threadMutex.unlock();
-#endif
+/*!
+ * \brief Takes the next job of class \a jobClass.  jobMutex must be locked.
+ * \param jobClass a JobClass.
+ * \param job the job taken.
+ * \return true if there was a job.
+ */
+bool FileInfoRetriever::takeJob(JobClass jobClass, Job &job)
+{
+    ageJobs();
 
-                currentJob.item = nullptr;
+    for (QQueue<Job> &queue : jobsQueue[jobClass]) {
+        while (!queue.isEmpty()) {
+            if (dequeueJob(queue, job))
+                return true;
+        }
+    }
+
+    return false;
+}
+
+/*!
+ * \brief Promotes the jobs that have been waiting for too long.  jobMutex must be locked.
+ *
+ * Every AGING_MSECS milliseconds a job waits it moves one priority up, so a continuous stream of higher priority
+ * jobs, like the icons of a folder being scrolled, can't starve the lower priority ones forever.
+ *
+ * Jobs never age into Foreground, which is only for what the user is waiting for.  The metadata of the rows on screen
+ * is queued at the front of Visible, so the aged metadata chunks of a big folder never get ahead of it.
+ *
+ * Prefetch and Housekeeping jobs are always queued at the back, so the ones waiting for too long are at the front of
+ * their queues and nothing else is looked at.
+ */
+void FileInfoRetriever::ageJobs()
+{
+    qint64 now = clock.elapsed();
+
+    if (now - lastAging < AGING_MSECS / 4)
+        return;
+
+    lastAging = now;
+
+    for (QQueue<Job> (&queues)[PriorityCount] : jobsQueue) {
+        for (int priority = Prefetch; priority < PriorityCount; priority++) {
+
+            QQueue<Job> &queue = queues[priority];
+
+            while (!queue.isEmpty() && now - queue.head().queuedAt >= AGING_MSECS) {
+
+                Job job;
+                if (!dequeueJob(queue, job))
+                    continue;
+
+                job.queuedAt = now;
+                job.priority = static_cast<Priority>(priority - 1);
+                if (job.type != Metadata)
+                    queuedJobs.insert(qMakePair(job.item, static_cast<int>(job.type)), QueuedJob { job.priority, job.serial, job.token });
+                queues[job.priority].enqueue(job);
             }
+        }
+    }
+}
+
+void FileInfoRetriever::runWorker(Worker *worker)
+{
+    currentWorker = worker;
+
+    JobClass jobClass = worker->jobClass;
 
-            running.store(false);
+    QMutexLocker locker(&jobMutex);
+
+    while (threadRunning.load()) {
+
+        drainJobs();
+
+        Job job;
+        if (!takeJob(jobClass, job)) {
+
+            // Go to sleep unless a job was pushed meanwhile.  The order of these operations matters: any producer
+            // either sees this worker idle and wakes it up, or its job is seen here
+            wakePending[jobClass].store(false);
+            idleWorkers[jobClass]++;
+            if (inbox.isEmpty() && threadRunning.load())
+                jobAvailable[jobClass].wait(&jobMutex);
+            idleWorkers[jobClass]--;
+            wakePending[jobClass].store(false);
+            continue;
         }
 
-        mutex.unlock();
+        // Let another sleeping worker take the next job
+        if (idleWorkers[jobClass].load() > 0)
+            jobAvailable[jobClass].wakeOne();
+
+        worker->currentJob = job;
+        locker.unlock();
+
+        runJob(job);
+
+        locker.relock();
+        worker->currentJob = Job {};
+
+        // The items removed while the job was using them
+        for (const QSharedPointer<Removal> &removal : qAsConst(worker->removals)) {
+            if (--removal->jobs == 0)
+                releaseItems(removal->items);
+        }
+        worker->removals.clear();
     }
-    qDebug() << "FileInfoRetriever::run finished";
+
+    currentWorker = nullptr;
+
+    qDebug() << "FileInfoRetriever::runWorker finished";
+}
+
+void FileInfoRetriever::runJob(const Job &job)
+{
+    // The job might have been cancelled right after it was taken
+    if (!isRunning())
+        return;
+
+#ifdef Q_OS_WIN
+    threadMutex.lock();
+#endif
+
+    switch(job.type) {
+
+        case Parent:
+            getParentBackground(job.item);
+            break;
+        case Children:
+            if (!job.item->areAllChildrenFetched()) {
+                currentWorker->arena = usingArenas ? new FileSystemItemArena() : nullptr;
+                getChildrenBackground(job.item);
+                if (currentWorker->arena != nullptr)
+                    currentWorker->arena->release();
+                currentWorker->arena = nullptr;
+            }
+            break;
+        case Icon:
+            getIconBackground(job.item);
+            break;
+        case Metadata:
+        case ItemMetadata:
+        case SubFolders:
+            runMetadataJob(job);
+            break;
+    }
+
+#ifdef Q_OS_WIN
+    threadMutex.unlock();
+#endif
 }
 
 /*!
  * \brief Gets all the children of a FileSystemItem parent.
  * \param parent a FileSystemItem
+ * \param priority Foreground if the user is waiting for them, or Prefetch if they are only likely to be needed.
  *
  * Gets all the children of a FileSystemItem parent (a folder or a drive) concurrently.
  *
  * The children will be retrieved on the background in a new thread.
+ *
+ * A Foreground request cancels the Foreground listing of any other folder that no view is showing anymore, since the
+ * model may be shared by several views.  Prefetches are never cancelled this way.
+ * If \a parent already has a listing queued with a lower priority, it's moved up.
  */
-void FileInfoRetriever::getChildren(FileSystemItem *parent)
+void FileInfoRetriever::getChildren(FileSystemItem *parent, Priority priority)
 {
     if (parent != nullptr) {
 
-        qDebug() << "FileInfoRetriever::getChildren" << parent->getPath();
+        qDebug() << "FileInfoRetriever::getChildren" << parent->getPath() << priority;
 
-        // Cancel everything for this model
+        // Cancel the listings nobody is waiting for anymore
         jobMutex.lock();
 
-        if (currentJob.item != nullptr && currentJob.type == Children && currentJob.item->getPath() != parent->getPath()) {
-            qDebug() << "FileInfoRetriever::getChildren cancelling current fetch of" << currentJob.item->getPath();
-            running.store(false);
+        for (Worker *worker : qAsConst(workerThreads)) {
+            const Job &currentJob = worker->currentJob;
+            if (priority == Foreground && currentJob.item != nullptr && currentJob.type == Children &&
+                    currentJob.priority == Foreground && currentJob.item->getPath() != parent->getPath() &&
+                    currentJob.item->getRefCounter() == 0) {
+                qDebug() << "FileInfoRetriever::getChildren cancelling current fetch of" << currentJob.item->getPath();
+                cancelJobs(currentJob.item);
+            }
         }
 
+        jobMutex.unlock();
+
         // Let's double check the children haven't been fetched
         if (!parent->areAllChildrenFetched()) {
-            addJob(parent, Children, true);
+            addJob(parent, Children, priority, priority == Foreground);
         } else
             qDebug() << "FileInfoRetriever::getChildren" << "all children were already fetched";
+    }
+}
 
-        jobMutex.unlock();
+/*!
+ * \brief Gets the metadata (size, dates and type) of the \a children of \a parent that don't have it yet.
+ * \param parent a FileSystemItem folder.
+ * \param children the children of \a parent, in the same order they were added to it.
+ *
+ * This is the second pass of a listing.  The children are processed in small chunks with the lowest priority, so the
+ * metadata of visible items (see getItemMetadata) is not delayed by a huge folder, and the chunks of several folders
+ * take turns.
+ *
+ * The childrenMetadataUpdated signal is emitted after every chunk, and parentMetadataUpdated when all the children
+ * are done.
+ */
+void FileInfoRetriever::getMetadata(FileSystemItem *parent, QList<FileSystemItem *> children)
+{
+    Job job;
+    job.item = parent;
+    job.type = Metadata;
+    job.priority = Housekeeping;
+    job.children = children;
+    job.offset = 0;
+
+    addJob(job);
+}
+
+/*!
+ * \brief Gets the metadata of \a item before any other pending job.
+ * \param item a FileSystemItem whose metadata is pending.
+ *
+ * This is used for items that are visible in a view while the metadata pass of their parent is still running.
+ */
+void FileInfoRetriever::getItemMetadata(FileSystemItem *item)
+{
+    if (item == nullptr || item->getParent() == nullptr)
+        return;
+
+    item->setMetadataState(FileSystemItem::MetadataRequested);
+
+    addJob(item, ItemMetadata, Visible, true);
+}
+
+/*!
+ * \brief Finds out in the background if the folder \a item has subfolders.
+ * \param item a FileSystemItem folder whose subfolders state is pending.
+ *
+ * The probe is queued before the other metadata jobs, since it's only requested for folders visible in a view.
+ * The subFoldersUpdated signal is emitted when it's done.
+ */
+void FileInfoRetriever::getSubFolders(FileSystemItem *item)
+{
+    if (item == nullptr || item->getParent() == nullptr)
+        return;
+
+    item->setSubFoldersState(FileSystemItem::SubFoldersRequested);
+
+    addJob(item, SubFolders, Visible, true);
+}
+
+/*!
+ * \brief Cancels all the jobs of the folder \a parent.  jobMutex must be locked.
+ * \param parent a FileSystemItem folder.
+ *
+ * The queued jobs are discarded, and the running ones are told to stop through their cancellation token, without
+ * waiting for them.  The jobs of other folders are not affected.
+ *
+ * All the jobs of the folder share the same token, so this takes constant time.  The queued ones are dropped when
+ * they're taken, and the new jobs of the folder get a new token.
+ *
+ * A cancelled listing frees the children it didn't publish yet and finishes with an error code of -1.
+ */
+void FileInfoRetriever::cancelJobs(FileSystemItem *parent)
+{
+    drainJobs();
+
+    Token token = ownerTokens.take(parent);
+    if (!token.isNull())
+        token->cancelled.store(true);
+}
+
+/*!
+ * \brief Deletes \a item and its descendants once no job uses them anymore.
+ * \param item a FileSystemItem already taken out of its parent, or the old root.
+ *
+ * The jobs of the whole subtree are discarded, and the metadata pass of the parent skips \a item from now on.  The
+ * running jobs that use any of them are not waited for, the items are deleted when the last of those jobs is done.
+ *
+ * Either way they're deleted in the thread of this object, after the signals about them the workers already sent, so
+ * the receivers of those signals can still look at them.  \sa deleteChildren
+ */
+void FileInfoRetriever::deleteItem(FileSystemItem *item)
+{
+    purgeJobs(item, true, QList<FileSystemItem *> { item });
+}
+
+/*!
+ * \brief Takes all the children out of the folder \a parent and deletes them once no job uses them anymore.
+ * \param parent a FileSystemItem folder.
+ *
+ * The jobs of \a parent itself that don't use its children, like its icon, are kept.  \sa deleteItem
+ */
+void FileInfoRetriever::deleteChildren(FileSystemItem *parent)
+{
+    purgeJobs(parent, false, parent->takeChildren());
+}
+
+/*!
+ * \brief Returns true if the jobs of the folder \a owner use \a folder or its descendants.
+ * \param subtree false if \a folder has no children, so only the jobs it owns can use them.
+ *
+ * Every job is owned by the folder of the items it uses, so it's enough to look for \a folder among the owner and its
+ * parents.  Owners are alive while they have jobs, since their jobs are removed before they're destroyed.
+ */
+bool FileInfoRetriever::isInSubtree(FileSystemItem *owner, FileSystemItem *folder, bool subtree)
+{
+    if (owner == folder)
+        return true;
+
+    if (!subtree)
+        return false;
+
+    for (FileSystemItem *ancestor = owner->getParent(); ancestor != nullptr; ancestor = ancestor->getParent()) {
+        if (ancestor == folder)
+            return true;
+    }
+
+    return false;
+}
+
+/*!
+ * \brief Discards the jobs that use \a item and its descendants, and deletes \a items when the running ones are done.
+ * \param item a FileSystemItem.
+ * \param withItem false if only the descendants of \a item are going away.
+ * \param items the items to delete, \a item itself or its children.
+ *
+ * jobMutex must not be locked.  The jobs of the folders of the subtree are cancelled through the tokens of the folders,
+ * so the queued jobs are not looked at.  Parents are only followed when there are descendants, so removing a file
+ * doesn't walk up from every folder with jobs.
+ *
+ * A running Metadata job of the parent of \a item is not aborted, since the chunk is short and the other children need
+ * it, but \a item is only deleted after it.  Its next chunks skip \a item.
+ */
+void FileInfoRetriever::purgeJobs(FileSystemItem *item, bool withItem, const QList<FileSystemItem *> &items)
+{
+    QMutexLocker locker(&jobMutex);
+
+    drainJobs();
+
+    FileSystemItem *parent = withItem ? item->getParent() : nullptr;
+    bool subtree = withItem ? item->childrenCount() > 0 : !items.isEmpty();
+
+    for (auto it = ownerTokens.begin(); it != ownerTokens.end();) {
+        if (isInSubtree(it.key(), item, subtree)) {
+            it.value()->cancelled.store(true);
+            it = ownerTokens.erase(it);
+        } else
+            ++it;
+    }
+
+    if (withItem) {
+
+        // The jobs of the item itself belong to its parent, they're dropped when they're taken
+        for (JobType type : { Icon, ItemMetadata, SubFolders })
+            queuedJobs.remove(qMakePair(item, static_cast<int>(type)));
+
+        Token token = ownerTokens.value(parent);
+        if (!token.isNull())
+            token->removed.insert(item);
     }
+
+    QSharedPointer<Removal> removal(new Removal { items, 0 });
+
+    for (Worker *worker : qAsConst(workerThreads)) {
+        const Job &job = worker->currentJob;
+        if (job.item == nullptr)
+            continue;
+
+        if (isInSubtree(job.owner, item, subtree) || (withItem && job.item == item) ||
+                (parent != nullptr && job.type == Metadata && job.item == parent)) {
+            worker->removals.append(removal);
+            removal->jobs++;
+        }
+    }
+
+    if (removal->jobs == 0)
+        releaseItems(items);
+}
+
+/*!
+ * \brief Deletes \a items in the thread of this object, after the signals the workers sent before.
+ *
+ * It can be called from any thread.
+ */
+void FileInfoRetriever::releaseItems(const QList<FileSystemItem *> &items)
+{
+    QMetaObject::invokeMethod(this, [items]() { FileSystemItem::deleteItems(items); }, Qt::QueuedConnection);
+}
+
+void FileInfoRetriever::runMetadataJob(Job job)
+{
+    if (job.type == SubFolders) {
+
+        if (job.item->getSubFoldersState() != FileSystemItem::SubFoldersKnown) {
+            getSubFoldersBackground(job.item);
+            emit subFoldersUpdated(job.item->getParent(), job.item);
+        }
+        return;
+    }
+
+    if (job.type == ItemMetadata) {
+
+        if (!job.item->isMetadataComplete()) {
+            QList<FileSystemItem *> children { job.item };
+            QVector<Metadata> metadata;
+            getMetadataBackground(job.item->getParent(), children, metadata);
+            emit childrenMetadataUpdated(job.item->getParent(), children, metadata, -1);
+        }
+        return;
+    }
+
+    QList<FileSystemItem *> chunk = job.children.mid(job.offset, METADATA_CHUNK_SIZE);
+
+    // The children removed meanwhile may not exist anymore \sa purgeJobs
+    jobMutex.lock();
+    if (!job.token->removed.isEmpty()) {
+        for (int i = chunk.size() - 1; i >= 0; i--) {
+            if (job.token->removed.contains(chunk.at(i)))
+                chunk.removeAt(i);
+        }
+    }
+    jobMutex.unlock();
+
+    QVector<Metadata> metadata;
+    getMetadataBackground(job.item, chunk, metadata);
+    emit childrenMetadataUpdated(job.item, chunk, metadata, job.offset);
+
+    job.offset += chunk.size();
+
+    if (!isRunning())
+        return;
+
+    if (job.offset < job.children.size()) {
+
+        // Queue the next chunk at the end
+        addJob(job);
+
+    } else
+        emit parentMetadataUpdated(job.item);
+}
+
+/*!
+ * \brief Gets the metadata of \a children of \a parent.
+ * \param parent a FileSystemItem folder.
+ * \param children a list of children of \a parent.
+ * \param metadata the metadata found for every child, in the same order.
+ *
+ * The children are not changed here, except for their flags, since they may be shown in a view already.  The metadata
+ * is set by applyMetadata() when childrenMetadataUpdated is received.
+ *
+ * Implementations that leave the metadata of the children pending must reimplement this function.
+ * This implementation just finds nothing, so the metadata of the children is marked as complete.
+ */
+void FileInfoRetriever::getMetadataBackground(FileSystemItem *parent, QList<FileSystemItem *> children, QVector<Metadata> &metadata)
+{
+    Q_UNUSED(parent)
+
+    metadata.fill(Metadata { true }, children.size());
+}
+
+/*!
+ * \brief Sets the \a metadata found by getMetadataBackground() to the \a children, and marks it as complete.
+ *
+ * This must be called in the thread of the model, unless nobody can see the children yet, so the size and dates of an
+ * item are never read while they're being written.  The children not fetched are not changed.
+ */
+void FileInfoRetriever::applyMetadata(const QList<FileSystemItem *> &children, const QVector<Metadata> &metadata)
+{
+    for (int i = 0; i < children.size() && i < metadata.size(); i++) {
+
+        const Metadata &childMetadata = metadata.at(i);
+        if (!childMetadata.fetched)
+            continue;
+
+        FileSystemItem *child = children.at(i);
+        child->setSize(childMetadata.size);
+        child->setCreationTimeNSecs(childMetadata.creationTime);
+        child->setLastAccessTimeNSecs(childMetadata.lastAccessTime);
+        child->setLastChangeTimeNSecs(childMetadata.lastChangeTime);
+        child->setMetadataState(FileSystemItem::MetadataComplete);
+    }
+}
+
+/*!
+ * \brief Finds out if the folder \a item has subfolders.
+ * \param item a FileSystemItem folder.
+ *
+ * Implementations that leave the subfolders state of the children pending must reimplement this function.
+ * This implementation just marks it as known.
+ */
+void FileInfoRetriever::getSubFoldersBackground(FileSystemItem *item)
+{
+    item->setSubFoldersState(FileSystemItem::SubFoldersKnown);
 }
 
 void FileInfoRetriever::getIcon(FileSystemItem *parent, bool background)
 {
-    if (background)
-        addJob(parent, Icon);
-    else
+    if (background) {
+        addJob(parent, Icon, Visible);
+    } else
         getIconBackground(parent, background);
 }
 
+/*!
+ * \brief Creates a child with the path \a path for the folder \a parent being listed.
+ *
+ * All the children of a listing are allocated from the same FileSystemItemArena, so they're freed together when the
+ * folder is removed, unless arenas are disabled.  getChildrenBackground() implementations should create their children
+ * with this function. \sa setUsingArenas
+ */
+FileSystemItem *FileInfoRetriever::newChild(FileSystemItem *parent, const QString &path)
+{
+    FileSystemItemArena *arena = (currentWorker != nullptr) ? currentWorker->arena : nullptr;
+    return new (arena) FileSystemItem(path, parent);
+}
+
+/*!
+ * \brief Creates a child named \a name, in the native encoding, for the folder \a parent being listed.
+ *
+ * Like newChild(), but no path is built nor decoded.
+ */
+FileSystemItem *FileInfoRetriever::newNamedChild(FileSystemItem *parent, const FileSystemItem::NativeString &name)
+{
+    FileSystemItemArena *arena = (currentWorker != nullptr) ? currentWorker->arena : nullptr;
+    return new (arena) FileSystemItem(parent, name);
+}
+
+/*!
+ * \brief Delivers a new \a child of \a parent.
+ * \param parent a FileSystemItem folder being fetched.
+ * \param child the new child.
+ *
+ * This function must be called from getChildrenBackground() for every child found.
+ *
+ * \sa setStreaming
+ */
+void FileInfoRetriever::addChild(FileSystemItem *parent, FileSystemItem *child)
+{
+    // The display name is final, make the collation key here instead of while sorting
+    child->prepareSortKey();
+
+    if (!streaming) {
+        parent->addChild(child);
+        return;
+    }
+
+    QList<FileSystemItem *> &pendingChildren = currentWorker->pendingChildren;
+
+    if (pendingChildren.isEmpty())
+        currentWorker->batchTimer.start();
+
+    pendingChildren.append(child);
+
+    if (pendingChildren.size() >= CHILDREN_BATCH_SIZE || currentWorker->batchTimer.elapsed() >= CHILDREN_BATCH_MSECS)
+        flushChildren(parent);
+}
+
+/*!
+ * \brief Publishes all the children of \a parent not delivered yet.
+ * \param parent a FileSystemItem folder being fetched.
+ *
+ * This function must be called from getChildrenBackground() before emitting parentChildrenUpdated.  If the fetch
+ * was cancelled (the error code of \a parent is -1) the pending children are destroyed instead.
+ */
+void FileInfoRetriever::flushChildren(FileSystemItem *parent)
+{
+    if (currentWorker == nullptr)
+        return;
+
+    QList<FileSystemItem *> &pendingChildren = currentWorker->pendingChildren;
+
+    if (pendingChildren.isEmpty())
+        return;
+
+    if (parent->getErrorCode() == -1)
+        qDeleteAll(pendingChildren);
+    else
+        emit parentChildrenAdded(parent, pendingChildren);
+
+    pendingChildren.clear();
+}
+
+/*!
+ * \brief Aborts the current jobs and waits for all the worker threads to finish.
+ */
 void FileInfoRetriever::quit()
 {
+    jobMutex.lock();
     threadRunning.store(false);
-    jobAvailable.wakeAll();
-    this->wait();
+
+    for (QWaitCondition &condition : jobAvailable)
+        condition.wakeAll();
+    jobMutex.unlock();
+
+    for (Worker *worker : qAsConst(workerThreads)) {
+        worker->wait();
+        delete worker;
+    }
+
+    workerThreads.clear();
 }
 
@@ -2,27 +2,83 @@
 #define FILEINFORETRIEVER_H
 
 #include <QWaitCondition>
+#include <QElapsedTimer>
+#include <QSharedPointer>
+#include <QHash>
+#include <QSet>
+#include <QVector>
+#include <QPair>
 #include <QAtomicInt>
-#include <QThread>
+#include <QObject>
 #include <QMutex>
+#include <QQueue>
 
 #include "FileSystemItem.h"
+#include "BoundedQueue.h"
 
-class FileInfoRetriever : public QThread
+class FileInfoRetriever : public QObject
 {
     Q_OBJECT
 
 public:
 
+    // Jobs are run by different groups of worker threads, so a long job of one class never delays the others
+    enum JobClass {
+        ListingJobs,
+        IconJobs,
+        MetadataJobs,
+        JobClassCount
+    };
+
+    // Lower values are run first
+    enum Priority {
+        Foreground,
+        Visible,
+        Prefetch,
+        Housekeeping,
+        PriorityCount
+    };
+
+    // The size and dates of a child found by a Metadata job.  The child may be shown in a view already, so they're set
+    // in the thread of the model \sa applyMetadata
+    struct Metadata {
+        bool        fetched             {};
+        quint64     size                { std::numeric_limits<quint64>::max() };
+        qint64      creationTime        { std::numeric_limits<qint64>::min() };
+        qint64      lastAccessTime      { std::numeric_limits<qint64>::min() };
+        qint64      lastChangeTime      { std::numeric_limits<qint64>::min() };
+    };
+
     FileInfoRetriever(QObject *parent = nullptr);
     ~FileInfoRetriever();
 
     virtual QString getRootPath() const;
 
+    bool isStreaming() const;
+    void setStreaming(bool value);
+
+    virtual bool isMetadataDeferred() const;
+
+    bool isUsingArenas() const;
+    void setUsingArenas(bool value);
+
+    int workerCount(JobClass jobClass) const;
+    void setWorkerCount(JobClass jobClass, int count);
+
+    void start();
+
     // These functions are executed in a separate thread
     void getInfo(FileSystemItem *parent);
-    void getChildren(FileSystemItem *parent);
+    void getChildren(FileSystemItem *parent, Priority priority = Foreground);
     void getIcon(FileSystemItem *parent, bool background = true);
+    void getMetadata(FileSystemItem *parent, QList<FileSystemItem *> children);
+    void getItemMetadata(FileSystemItem *item);
+    void getSubFolders(FileSystemItem *item);
+
+    void deleteItem(FileSystemItem *item);
+    void deleteChildren(FileSystemItem *parent);
+
+    static void applyMetadata(const QList<FileSystemItem *> &children, const QVector<Metadata> &metadata);
 
     // These functions are not executed in a separated thread
     virtual bool refreshItem(FileSystemItem *fileSystemItem) = 0;
@@ -35,6 +91,10 @@ signals:
     // New ones
     void parentInfoUpdated(FileSystemItem *parent);
     void parentChildrenUpdated(FileSystemItem *parent);
+    void parentChildrenAdded(FileSystemItem *parent, QList<FileSystemItem *> children);
+    void parentMetadataUpdated(FileSystemItem *parent);
+    void childrenMetadataUpdated(FileSystemItem *parent, QList<FileSystemItem *> children, QVector<FileInfoRetriever::Metadata> metadata, int firstRow);
+    void subFoldersUpdated(FileSystemItem *parent, FileSystemItem *item);
     void iconUpdated(FileSystemItem *item);
 
 
@@ -42,16 +102,27 @@ public slots:
     void quit();
 
 protected:
-    QAtomicInt running;
-
-    void run() override;
+    bool isRunning() const;
 
     virtual void getChildrenBackground(FileSystemItem *parent) = 0;
     virtual bool getParentBackground(FileSystemItem *parent) = 0;
     virtual void getIconBackground(FileSystemItem *parent, bool background = true) = 0;
+    virtual void getMetadataBackground(FileSystemItem *parent, QList<FileSystemItem *> children, QVector<Metadata> &metadata);
+    virtual void getSubFoldersBackground(FileSystemItem *item);
+
+    // Used by getChildrenBackground() implementations to create and deliver children
+    FileSystemItem *newChild(FileSystemItem *parent, const QString &path);
+    FileSystemItem *newNamedChild(FileSystemItem *parent, const FileSystemItem::NativeString &name);
+    void addChild(FileSystemItem *parent, FileSystemItem *child);
+    void flushChildren(FileSystemItem *parent);
 
 private:
 
+    class Worker;
+
+    bool streaming                  {};
+    bool usingArenas                { true };
+
     QAtomicInt threadRunning;
     QMutex jobMutex;
 
@@ -69,21 +140,104 @@ private:
 
         Parent,
         Children,
-        Icon
+        Icon,
+        Metadata,
+        ItemMetadata,
+        SubFolders
+    };
+
+    // Shared by all the jobs of the same folder queued since it was last cancelled, so cancelling all of them takes
+    // constant time \sa cancelJobs
+    struct JobState {
+
+        // Set to true to cancel the jobs
+        QAtomicInt cancelled;
+
+        // Children of the folder removed meanwhile, its Metadata jobs skip them.  Guarded by jobMutex
+        QSet<FileSystemItem *> removed;
+    };
+
+    typedef QSharedPointer<JobState> Token;
+
+    // Items removed while some jobs were using them, deleted when the last of those jobs is done \sa deleteItem
+    struct Removal {
+        QList<FileSystemItem *> items;
+        int jobs;
     };
 
     typedef struct _job {
 
         FileSystemItem *item;
         JobType type;
+        Priority priority;
+
+        // The folder this job belongs to, and its cancellation token
+        FileSystemItem *owner;
+        Token token;
+
+        // Time the job was queued, to promote jobs that have been waiting for too long
+        qint64 queuedAt;
+
+        bool insertAtFront;
+
+        // Tells the job from older ones of the same item and type merged into it \sa queueJob
+        quint64 serial;
+
+        // Only for Metadata jobs
+        QList<FileSystemItem *> children;
+        int offset;
 
     } Job;
 
-    QList<Job> jobsQueue;
-    QWaitCondition jobAvailable;
-    Job currentJob;
+    // New jobs are pushed here without locking, and moved to the priority queues by the workers
+    BoundedQueue<Job> inbox;
+
+    // One FIFO per class and priority, all of them guarded by jobMutex.  Cancelled jobs are skipped when they're taken
+    QQueue<Job> jobsQueue[JobClassCount][PriorityCount];
+    QWaitCondition jobAvailable[JobClassCount];
+    QElapsedTimer clock;
+    qint64 lastAging                {};
+
+    // Every job in the queues, so a repeated request for the same item and type is merged.  Guarded by jobMutex
+    struct QueuedJob {
+        Priority priority;
+        quint64 serial;
+        Token token;
+    };
 
-    void addJob(FileSystemItem *item, FileInfoRetriever::JobType type, bool insertAtFront = false);
+    QHash<QPair<FileSystemItem *, int>, QueuedJob> queuedJobs;
+    quint64 lastSerial              {};
+
+    // The token of every folder with jobs.  Guarded by jobMutex
+    QHash<FileSystemItem *, Token> ownerTokens;
+
+    // Used to wake up sleeping workers only when there are any, and only once for a burst of new jobs
+    std::atomic<int> idleWorkers[JobClassCount]     {};
+    std::atomic<bool> wakePending[JobClassCount]    {};
+
+    int workers[JobClassCount];
+    QList<Worker *> workerThreads;
+
+    // The worker running in the current thread, or nullptr if this is not a worker thread
+    static thread_local Worker *currentWorker;
+
+    static JobClass jobClass(JobType type);
+
+    void addJob(FileSystemItem *item, FileInfoRetriever::JobType type, Priority priority, bool insertAtFront = false);
+    void addJob(Job job, bool insertAtFront = false);
+    void queueJob(Job job);
+    bool dequeueJob(QQueue<Job> &queue, Job &job);
+    void drainJobs();
+    void wakeWorker(JobClass jobClass);
+    bool takeJob(JobClass jobClass, Job &job);
+    void ageJobs();
+    void cancelJobs(FileSystemItem *parent);
+    void purgeJobs(FileSystemItem *item, bool withItem, const QList<FileSystemItem *> &items);
+    void releaseItems(const QList<FileSystemItem *> &items);
+    static bool isInSubtree(FileSystemItem *owner, FileSystemItem *folder, bool subtree);
+    void runWorker(Worker *worker);
+    void runJob(const Job &job);
+    void runMetadataJob(Job job);
 
 };
 
@@ -1,58 +1,254 @@
 #include <QFileIconProvider>
 #include <QApplication>
-#include <QMimeDatabase>
 #include <QLocale>
+#include <QFile>
+#include <QDir>
+#include <QMutex>
+#include <QSet>
 #include <QDebug>
 
+#include <algorithm>
+#include <cstring>
+
 #include "FileSystemItem.h"
+#include "FileTypeCache.h"
+#include "Collation.h"
+#include "NameIndex.h"
+
+// Stored instead of the time when a date is not known
+#define INVALID_TIME                std::numeric_limits<qint64>::min()
+
+#define NSECS_PER_MSEC              1'000'000LL
+
+// Marks the place of a removed child in a ChildrenIndex, so the lookups keep probing past it
+#define INDEX_TOMBSTONE             reinterpret_cast<FileSystemItem *>(quintptr(1))
+
+#define INDEX_MIN_CAPACITY          8
+
+// Maximum number of different types shared by the items, the rest get their own copy
+#define INTERN_MAX_STRINGS          4096
+
+// Number of folder paths cached, must be a power of two.  Files are not cached, their paths are built from the folders
+#define PATH_CACHE_SIZE             256
+
+#if QT_POINTER_SIZE == 8
+static_assert(sizeof(FileSystemItem) <= 112, "FileSystemItem is larger than expected");
+#endif
+
+// Every item is preceded by the arena it was allocated from, or nullptr if it was allocated alone
+struct AllocationHeader {
+    FileSystemItemArena *arena;
+};
+
+static_assert(sizeof(AllocationHeader) % alignof(FileSystemItem) == 0, "Items would be misaligned");
+
+namespace {
+
+// The paths of the folders used lately, so building a path doesn't walk up the whole tree every time
+struct PathCacheEntry {
+    std::atomic<const FileSystemItem *> item {};
+    quint32     generation          {};
+    FileSystemItem::NativeString path {};
+};
+
+PathCacheEntry pathCache[PATH_CACHE_SIZE];
+QMutex pathCacheMutex;
+
+// Increased every time an item changes its path, so all the cached paths are built again
+std::atomic<quint32> pathGeneration { 0 };
+
+inline PathCacheEntry &pathCacheEntry(const FileSystemItem *item)
+{
+    return pathCache[qHash(item) & (PATH_CACHE_SIZE - 1)];
+}
+
+#ifdef Q_OS_WIN
+inline bool isSeparator(QChar c)
+{
+    return c == '/' || c == '\\';
+}
 
-FileSystemItem::FileSystemItem(QString path)
+const QChar nativeSeparator = '\\';
+#else
+inline bool isSeparator(char c)
 {
-    this->path = path;
+    return c == '/';
+}
+
+const char nativeSeparator = '/';
+#endif
+
+}
+
+/*!
+ * \brief Creates an item with the path \a path.
+ * \param path the absolute path of the item.
+ * \param parent the folder the item is going to be added to, if known.
+ *
+ * If \a path is right below the path of \a parent only the name is stored.
+ */
+FileSystemItem::FileSystemItem(QString path, FileSystemItem *parent)
+{
+    this->parent = parent;
+    assignPath(toNative(path));
+}
+
+/*!
+ * \brief Creates an item named \a name right below \a parent.
+ * \param name the name of the item in the native encoding, without any separator.
+ *
+ * This is how retrievers create the children they list, no path is built or decoded.
+ */
+FileSystemItem::FileSystemItem(FileSystemItem *parent, const NativeString &name)
+{
+    this->parent = parent;
+    this->name = name;
 }
 
 FileSystemItem::~FileSystemItem()
 {
     removeChildren();
+    delete folderData.load();
+    delete[] sortKey.load();
+    forgetPath();
+}
+
+void *FileSystemItem::operator new(size_t size)
+{
+    AllocationHeader *header = static_cast<AllocationHeader *>(::operator new(sizeof(AllocationHeader) + size));
+    header->arena = nullptr;
+    return header + 1;
+}
+
+/*!
+ * \brief Allocates an item from \a arena.
+ *
+ * The item is deleted as usual, its storage goes back to the arena and it's freed with the rest of the arena.
+ */
+void *FileSystemItem::operator new(size_t size, FileSystemItemArena *arena)
+{
+    if (arena == nullptr)
+        return operator new(size);
+
+    AllocationHeader *header = static_cast<AllocationHeader *>(arena->allocate(sizeof(AllocationHeader) + size));
+    header->arena = arena;
+    return header + 1;
+}
+
+void FileSystemItem::operator delete(void *pointer)
+{
+    if (pointer == nullptr)
+        return;
+
+    AllocationHeader *header = static_cast<AllocationHeader *>(pointer) - 1;
+    if (header->arena != nullptr)
+        header->arena->release();
+    else
+        ::operator delete(header);
 }
 
+void FileSystemItem::operator delete(void *pointer, FileSystemItemArena *)
+{
+    operator delete(pointer);
+}
+
+/*!
+ * \brief Returns the name shown to the user.
+ *
+ * Unless it was set to something else, this is the name of the item.  It's decoded the first time it's asked for, and
+ * kept.  Several threads may ask for it at the same time, only the first one keeps it.
+ */
 QString FileSystemItem::getDisplayName() const
 {
-    return displayName;
+    if ((flags.load(std::memory_order_acquire) & (DisplayNameFlag | DecodedNameFlag)) || testFlag(AbsolutePathFlag))
+        return displayName;
+
+    QString decodedName = fromNative(name);
+    if (!(flags.fetch_or(DecodingNameFlag, std::memory_order_acquire) & DecodingNameFlag)) {
+        displayName = decodedName;
+        flags.fetch_or(DecodedNameFlag, std::memory_order_release);
+    }
+
+    return decodedName;
 }
 
+/*!
+ * \brief Sets the name shown to the user to \a value, and the extension of files from it.
+ *
+ * Retrievers don't call this for the items displayed with their names, those are decoded when needed.
+ */
 void FileSystemItem::setDisplayName(const QString &value)
 {
-#ifdef Q_OS_WIN
-#define MIN_INDEX -1
-#else
-#define MIN_INDEX 0
-#endif
+    bool indexed = testFlag(IndexedFlag) && parent != nullptr;
+    if ((sortKey.load() != nullptr || indexed) && value != getDisplayName()) {
+        delete[] sortKey.exchange(nullptr);
+
+        if (indexed)
+            NameIndex::invalidate(parent);
+    }
 
     displayName = value;
+    flags.fetch_or(DisplayNameFlag, std::memory_order_release);
 
-    if (!isFolder()) {
-        QMimeDatabase mimeDatabase;
-        QString suffix;
-        try {
-            suffix = mimeDatabase.suffixForFileName(value);
-        }  catch (const std::exception& e) {
-            qDebug() << "FileSystemItem::setDisplayName exception" << e.what();
-        }
+    // The cache already shares the extensions between all the items
+    if (!isFolder())
+        extension = FileTypeCache::lookup(value).extension;
+}
 
-        if (suffix.isEmpty()) {
-            int index = getDisplayName().lastIndexOf('.');
-            suffix = (index > MIN_INDEX) ? getDisplayName().mid(++index) : QString();
-        }
-        extension = suffix;
+/*!
+ * \brief Returns the collation key of the display name, to be compared with strcmp().
+ *
+ * The key is made the first time it's asked for, and again after the locale changes.  Only the GUI thread may call
+ * this, since it may replace a stale key.  Other threads call prepareSortKey().
+ */
+const char *FileSystemItem::getSortKey() const
+{
+    char *key = sortKey.load();
+
+    if (key == nullptr || !Collation::isCurrent(key)) {
+        char *newKey = Collation::newStampedKey(getDisplayName());
+
+        // Other threads only set a key where there was none
+        if (sortKey.compare_exchange_strong(key, newKey)) {
+            delete[] key;
+            key = newKey;
+        } else
+            delete[] newKey;
     }
+
+    return Collation::keyOf(key);
+}
+
+/*!
+ * \brief Makes the collation key of the display name if there's none yet.
+ *
+ * Retrievers call this for the items whose display name is final, so sorting them doesn't have to.  It can be called
+ * from any thread.
+ */
+void FileSystemItem::prepareSortKey() const
+{
+    if (sortKey.load() != nullptr)
+        return;
+
+    char *newKey = Collation::newStampedKey(getDisplayName());
+    char *key = nullptr;
+    if (!sortKey.compare_exchange_strong(key, newKey))
+        delete[] newKey;
 }
 
 void FileSystemItem::addChild(FileSystemItem *child)
 {
+    FolderData *data = getFolderData();
+
     child->setParent(this);
-    children.insert(child->path, child);
-    indexedChildren.append(child);
+    child->row = data->indexedChildren.size();
+    data->children.insert(child);
+    data->indexedChildren.append(child);
+
+    if (testFlag(IndexedFlag)) {
+        child->setFlag(IndexedFlag, true);
+        NameIndex::add(this, child);
+    }
 }
 
 FileSystemItem *FileSystemItem::getParent() const
@@ -60,107 +256,509 @@ FileSystemItem *FileSystemItem::getParent() const
     return parent;
 }
 
+/*!
+ * \brief Moves this item to the folder \a value.  The item keeps its path.
+ */
 void FileSystemItem::setParent(FileSystemItem *value)
 {
+    if (value == parent)
+        return;
+
+    NativeString path = getNativePath();
     parent = value;
+    assignPath(path);
 }
 
 FileSystemItem *FileSystemItem::getChildAt(int n)
 {
-    return indexedChildren.at(n);
+    return folderData.load()->indexedChildren.at(n);
 }
 
 FileSystemItem *FileSystemItem::getChild(QString path)
 {
-    return children.value(path);
+    FolderData *data = folderData.load();
+    if (data == nullptr)
+        return nullptr;
+
+    NativeString nativePath = toNative(path);
+    return data->children.find(nativePath, childNameStart(nativePath, getFolderPath()));
 }
 
+/*!
+ * \brief Removes the child with the path \a path, without deleting it.
+ *
+ * The children after it move up one row, so this takes linear time, and removing k of the n children of a folder one
+ * by one takes O(n·k).  That's only an issue for refreshes that find many children gone at once.
+ */
 void FileSystemItem::removeChild(QString path)
 {
     // This does not delete child, caller has to delete it.
     FileSystemItem *item = getChild(path);
     if (item) {
-        children.remove(path);
-        indexedChildren.removeOne(item);
+        FolderData *data = folderData.load();
+        data->children.remove(item);
+
+        int row = childRow(item);
+        int folder = findFolder(data, row);
+        if (folder < data->folders.size() && data->folders.at(folder) == item)
+            data->folders.remove(folder);
+
+        data->indexedChildren.removeAt(row);
+        item->row = -1;
+
+        // The children after it move up one row
+        for (int i = row; i < data->indexedChildren.size(); i++)
+            data->indexedChildren.at(i)->row = i;
+
+        if (testFlag(IndexedFlag))
+            NameIndex::invalidate(this);
     }
 }
 
 QList<FileSystemItem *> FileSystemItem::getChildren()
 {
-    return indexedChildren;
+    FolderData *data = folderData.load();
+    return (data != nullptr) ? data->indexedChildren : QList<FileSystemItem *>();
 }
 
 void FileSystemItem::removeChildren()
 {
-    for (FileSystemItem *item : qAsConst(indexedChildren))
-        if (item->hasSubFolders)
-            item->removeChildren();
+    FolderData *data = folderData.load();
+    if (data == nullptr)
+        return;
+
+    deleteItems(data->indexedChildren);
+    clear();
+}
 
-    qDeleteAll(indexedChildren);
+/*!
+ * \brief Removes all the children without deleting them, and returns them.
+ *
+ * The caller has to delete them, with deleteItems().
+ */
+QList<FileSystemItem *> FileSystemItem::takeChildren()
+{
+    QList<FileSystemItem *> children = getChildren();
     clear();
+    return children;
 }
 
+/*!
+ * \brief Deletes all the \a items and their descendants.
+ */
+void FileSystemItem::deleteItems(const QList<FileSystemItem *> &items)
+{
+    // The children of a listing are next to each other, so the ones of the same arena give back their references to
+    // it at once instead of one by one.  Their descendants are removed by their destructors
+    FileSystemItemArena *arena = nullptr;
+    int references = 0;
+
+    for (FileSystemItem *item : items) {
+
+        AllocationHeader *header = reinterpret_cast<AllocationHeader *>(item) - 1;
+        if (header->arena == nullptr) {
+            delete item;
+            continue;
+        }
+
+        if (header->arena != arena) {
+            if (arena != nullptr)
+                arena->release(references);
+            arena = header->arena;
+            references = 0;
+        }
+
+        item->~FileSystemItem();
+        references++;
+    }
+
+    if (arena != nullptr)
+        arena->release(references);
+}
+
+/*!
+ * \brief Changes the path of \a child to \a path.
+ *
+ * The descendants of \a child only store their names, so their paths follow it and they're not touched at all.
+ */
 void FileSystemItem::updateChildPath(FileSystemItem *child, QString path)
 {
-    QString oldPath = child->getPath();
+    FolderData *data = getFolderData();
+    data->children.remove(child);
     child->setPath(path);
+    data->children.insert(child);
 
-    children.remove(oldPath);
-    children.insert(path, child);
+    if (testFlag(IndexedFlag))
+        NameIndex::invalidate(this);
 }
 
 int FileSystemItem::childrenCount()
 {
-    return children.size();
+    FolderData *data = folderData.load();
+    return (data != nullptr) ? data->indexedChildren.size() : 0;
 }
 
+/*!
+ * \brief Returns the row of \a child, or -1 if it's not a child of this item.
+ *
+ * Every child knows its row, so this takes constant time.  \a child must be a valid item, use findChildRow() if it
+ * might have been deleted.
+ */
 int FileSystemItem::childRow(FileSystemItem *child) {
-    return indexedChildren.indexOf(child);
+    FolderData *data = folderData.load();
+    if (data == nullptr || child->parent != this)
+        return -1;
+
+    int row = child->row;
+    return (row >= 0 && row < data->indexedChildren.size() && data->indexedChildren.at(row) == child) ? row : -1;
+}
+
+/*!
+ * \brief Returns the row of \a child, or -1 if it's not a child of this item.
+ *
+ * Unlike childRow(), \a child is never dereferenced, so it can be an item that was removed and deleted meanwhile.
+ * This takes linear time.
+ */
+int FileSystemItem::findChildRow(FileSystemItem *child) {
+    FolderData *data = folderData.load();
+    return (data != nullptr) ? data->indexedChildren.indexOf(child) : -1;
+}
+
+int FileSystemItem::foldersCount()
+{
+    FolderData *data = folderData.load();
+    return (data != nullptr) ? data->folders.size() : 0;
+}
+
+/*!
+ * \brief Returns the \a n th child of this item that is a folder or a drive.
+ */
+FileSystemItem *FileSystemItem::getFolderAt(int n)
+{
+    return folderData.load()->folders.at(n);
+}
+
+/*!
+ * \brief Returns the position of \a child among the folders of this item, or -1 if it's not one of them.
+ *
+ * The folders are in the order of their rows, so this takes logarithmic time.
+ */
+int FileSystemItem::folderRow(FileSystemItem *child)
+{
+    int row = childRow(child);
+    if (row < 0)
+        return -1;
+
+    FolderData *data = folderData.load();
+    int folder = findFolder(data, row);
+    return (folder < data->folders.size() && data->folders.at(folder) == child) ? folder : -1;
+}
+
+/*!
+ * \brief Returns the number of folders of this item in the rows before \a row.
+ *
+ * The folders in the rows \c first to \c last are then the ones from foldersBefore(first) to foldersBefore(last + 1).
+ */
+int FileSystemItem::foldersBefore(int row)
+{
+    FolderData *data = folderData.load();
+    return (data != nullptr) ? findFolder(data, row) : 0;
+}
+
+/*!
+ * \brief Returns the position of the first folder of \a data whose row is \a row or after it.
+ */
+int FileSystemItem::findFolder(const FolderData *data, int row) const
+{
+    auto folder = std::lower_bound(data->folders.cbegin(), data->folders.cend(), row,
+                                   [](const FileSystemItem *item, int value) { return item->row < value; });
+
+    return static_cast<int>(folder - data->folders.cbegin());
+}
+
+/*!
+ * \brief Adds \a child to the folders, or takes it out of them, after it became or stopped being a folder.
+ * \return true if the folders changed.
+ *
+ * New children are not added to the folders by addChild(), and the type of a child may change in any thread.  The
+ * folders are only updated by the FolderModel, in the GUI thread, so it can tell the views first.
+ */
+bool FileSystemItem::updateFolder(FileSystemItem *child)
+{
+    int row = childRow(child);
+    if (row < 0)
+        return false;
+
+    FolderData *data = folderData.load();
+    int folder = findFolder(data, row);
+    bool listed = folder < data->folders.size() && data->folders.at(folder) == child;
+
+    if (child->isFolderOrDrive() && !listed)
+        data->folders.insert(folder, child);
+    else if (!child->isFolderOrDrive() && listed)
+        data->folders.remove(folder);
+    else
+        return false;
+
+    return true;
+}
+
+/*!
+ * \brief Returns the children containers of this item, creating them the first time.
+ *
+ * Several threads may ask for them at the same time, only one of them creates them.
+ */
+FileSystemItem::FolderData *FileSystemItem::getFolderData()
+{
+    FolderData *data = folderData.load();
+    if (data == nullptr) {
+        FolderData *newData = new FolderData;
+        if (folderData.compare_exchange_strong(data, newData))
+            data = newData;
+        else
+            delete newData;
+    }
+
+    return data;
+}
+
+/*!
+ * \brief Returns the child with the native path \a path, or nullptr if there's none.
+ * \param nameStart where the last component of \a path starts if it's right below this folder, or -1.
+ *
+ * Children that only store their names are compared with the last component, the rest with the whole path.
+ */
+FileSystemItem *FileSystemItem::ChildrenIndex::find(const NativeString &path, int nameStart) const
+{
+    if (table.isEmpty())
+        return nullptr;
+
+    int mask = table.size() - 1;
+    const FileSystemItem *const *entries = table.constData();
+
+    // There's always an empty slot, see insert()
+    for (int i = static_cast<int>(hash(path)) & mask; entries[i] != nullptr; i = (i + 1) & mask) {
+        if (entries[i] == INDEX_TOMBSTONE)
+            continue;
+
+        const FileSystemItem *child = entries[i];
+        if (child->testFlag(AbsolutePathFlag)) {
+            if (child->name == path)
+                return const_cast<FileSystemItem *>(child);
+        } else if (nameStart >= 0 && child->name.size() == path.size() - nameStart &&
+                   memcmp(child->name.constData(), path.constData() + nameStart, sizeof(*path.constData()) * child->name.size()) == 0)
+            return const_cast<FileSystemItem *>(child);
+    }
+
+    return nullptr;
+}
+
+void FileSystemItem::ChildrenIndex::insert(FileSystemItem *child)
+{
+    // Keep at least a quarter of the table empty, so the probes are short
+    if ((count + tombstones + 1) * 4 > table.size() * 3) {
+        int capacity = INDEX_MIN_CAPACITY;
+        while (capacity < (count + 1) * 2)
+            capacity <<= 1;
+        rehash(capacity);
+    }
+
+    place(child);
 }
 
+/*!
+ * \brief Removes \a child.  Its name must be the same it had when it was inserted.
+ */
+void FileSystemItem::ChildrenIndex::remove(FileSystemItem *child)
+{
+    if (table.isEmpty())
+        return;
+
+    int mask = table.size() - 1;
+    FileSystemItem **entries = table.data();
+
+    for (int i = static_cast<int>(hash(child->name)) & mask; entries[i] != nullptr; i = (i + 1) & mask) {
+        if (entries[i] == child) {
+            entries[i] = INDEX_TOMBSTONE;
+            count--;
+            tombstones++;
+            return;
+        }
+    }
+}
+
+void FileSystemItem::ChildrenIndex::clear()
+{
+    table.clear();
+    count = 0;
+    tombstones = 0;
+}
+
+void FileSystemItem::ChildrenIndex::place(FileSystemItem *child)
+{
+    int mask = table.size() - 1;
+    FileSystemItem **entries = table.data();
+
+    int i = static_cast<int>(hash(child->name)) & mask;
+    while (entries[i] != nullptr && entries[i] != INDEX_TOMBSTONE)
+        i = (i + 1) & mask;
+
+    if (entries[i] == INDEX_TOMBSTONE)
+        tombstones--;
+
+    entries[i] = child;
+    count++;
+}
+
+void FileSystemItem::ChildrenIndex::rehash(int capacity)
+{
+    QVector<FileSystemItem *> oldTable;
+    oldTable.swap(table);
+
+    table = QVector<FileSystemItem *>(capacity, nullptr);
+    count = 0;
+    tombstones = 0;
+
+    for (FileSystemItem *child : qAsConst(oldTable)) {
+        if (child != nullptr && child != INDEX_TOMBSTONE)
+            place(child);
+    }
+}
+
+/*!
+ * \brief Hashes the last component of \a path, ignoring trailing separators like the ones of drives.
+ */
+uint FileSystemItem::ChildrenIndex::hash(const NativeString &path)
+{
+    int end = path.size();
+    while (end > 1 && isSeparator(path.at(end - 1)))
+        end--;
+
+    int start = end;
+    while (start > 0 && !isSeparator(path.at(start - 1)))
+        start--;
+
+    return qHash(NativeString::fromRawData(path.constData() + start, end - start));
+}
+
+void FileSystemItem::setFlag(Flag flag, bool value)
+{
+    if (value)
+        flags.fetch_or(flag, std::memory_order_relaxed);
+    else
+        flags.fetch_and(~static_cast<quint32>(flag), std::memory_order_relaxed);
+}
+
+quint32 FileSystemItem::getState(StateShift shift, quint32 mask) const
+{
+    return (flags.load(std::memory_order_relaxed) >> shift) & mask;
+}
+
+void FileSystemItem::setState(StateShift shift, quint32 mask, quint32 value)
+{
+    quint32 oldFlags = flags.load(std::memory_order_relaxed);
+    quint32 newFlags;
+    do {
+        newFlags = (oldFlags & ~(mask << shift)) | ((value & mask) << shift);
+    } while (!flags.compare_exchange_weak(oldFlags, newFlags, std::memory_order_relaxed));
+}
+
+/*!
+ * \brief Returns a copy of \a value that shares its data with every other item that has the same value.
+ *
+ * Types repeat a lot, so every item keeps only a pointer to the same string.
+ */
+QString FileSystemItem::intern(const QString &value)
+{
+    static QMutex mutex;
+    static QSet<QString> strings;
+
+    if (value.isEmpty())
+        return value;
+
+    QMutexLocker locker(&mutex);
+
+    auto string = strings.constFind(value);
+    if (string != strings.cend())
+        return *string;
+
+    if (strings.size() < INTERN_MAX_STRINGS)
+        strings.insert(value);
+
+    return value;
+}
+
+QDateTime FileSystemItem::toDateTime(qint64 nsecs)
+{
+    return (nsecs != INVALID_TIME) ? QDateTime::fromMSecsSinceEpoch(nsecs / NSECS_PER_MSEC) : QDateTime();
+}
+
+qint64 FileSystemItem::fromDateTime(const QDateTime &dateTime)
+{
+    return dateTime.isValid() ? dateTime.toMSecsSinceEpoch() * NSECS_PER_MSEC : INVALID_TIME;
+}
 
 bool FileSystemItem::getHasSubFolders() const
 {
-    return hasSubFolders;
+    return testFlag(HasSubFoldersFlag);
 }
 
 void FileSystemItem::setHasSubFolders(bool value)
 {
-    hasSubFolders = value;
+    setFlag(HasSubFoldersFlag, value);
 }
 
 bool FileSystemItem::areAllChildrenFetched() const
 {
-    return allChildrenFetched;
+    return testFlag(AllChildrenFetchedFlag);
 }
 
 void FileSystemItem::setAllChildrenFetched(bool value)
 {
-    allChildrenFetched = value;
+    setFlag(AllChildrenFetchedFlag, value);
 }
 
 bool FileSystemItem::isDrive() const
 {
-    return (!path.isNull() && path.length() == 3 && path.at(0).isLetter() && path.at(1) == ':' && path.at(2) == '\\');
+#ifdef Q_OS_WIN
+    return (testFlag(AbsolutePathFlag) && name.length() == 3 && name.at(0).isLetter() && name.at(1) == ':' && name.at(2) == '\\');
+#else
+    return false;
+#endif
+}
+
+bool FileSystemItem::isFolderOrDrive() const
+{
+    return isFolder() || isDrive();
 }
 
 bool FileSystemItem::isInADrive() const
 {
+#ifdef Q_OS_WIN
+    // The path starts with the first ancestor that stores a whole path
+    const FileSystemItem *item = this;
+    while (!item->testFlag(AbsolutePathFlag))
+        item = item->parent;
+
+    const QString &path = item->name;
     return (!path.isNull() && path.length() >= 3 && path.at(0).isLetter() && path.at(1) == ':' && path.at(2) == '\\');
+#else
+    return false;
+#endif
 }
 
 bool FileSystemItem::isEqualTo(FileSystemItem *item) const
 {
-    if (path != item->getPath())
+    if (!hasSamePath(item))
         return false;
 
-    if (displayName != item->getDisplayName() || size != item->getSize() || capabilities != item->getCapabilities())
+    if (getDisplayName() != item->getDisplayName() || size != item->getSize() || getCapabilities() != item->getCapabilities())
         return false;
 
-    if (creationTime != item->getCreationTime() || lastAccessTime != item->getLastAccessTime() || lastChangeTime != item->lastChangeTime)
+    if (creationTime != item->creationTime || lastAccessTime != item->lastAccessTime || lastChangeTime != item->lastChangeTime)
         return false;
 
-    if (folder != item->isFolder() || hasSubFolders != item->getHasSubFolders() || hidden != item->isHidden())
+    if (isFolder() != item->isFolder() || getHasSubFolders() != item->getHasSubFolders() || isHidden() != item->isHidden())
         return false;
 
     return true;
@@ -168,12 +766,182 @@ bool FileSystemItem::isEqualTo(FileSystemItem *item) const
 
 QString FileSystemItem::getPath() const
 {
-    return path;
+    return fromNative(getNativePath());
 }
 
+/*!
+ * \brief Changes the path of this item.  The paths of all its descendants change with it.
+ *
+ * Use FileSystemItem::updateChildPath() for items that have a parent, so it can find them by their new path.
+ */
 void FileSystemItem::setPath(const QString &value)
 {
-    path = value;
+    assignPath(toNative(value));
+
+    // The paths cached for the descendants are wrong now
+    pathGeneration++;
+
+    // And the display name may be the new name
+    delete[] sortKey.exchange(nullptr);
+}
+
+/*!
+ * \brief Returns the absolute path of this item in the native encoding.
+ *
+ * Only the name of the item is stored, so the path is built from the path of its parent.  The paths of the folders
+ * are cached, so this usually takes a single concatenation.
+ *
+ * On Unix this is what the system calls take, so it should be used instead of getPath() for them.
+ */
+FileSystemItem::NativeString FileSystemItem::getNativePath() const
+{
+    if (testFlag(AbsolutePathFlag))
+        return name;
+
+    NativeString folderPath = parent->getFolderPath();
+    if (folderPath.isEmpty() || !isSeparator(folderPath.at(folderPath.size() - 1)))
+        folderPath.append(nativeSeparator);
+
+    return folderPath + name;
+}
+
+/*!
+ * \brief Returns the last component of the path of this item in the native encoding.
+ */
+FileSystemItem::NativeString FileSystemItem::getNativeName() const
+{
+    if (!testFlag(AbsolutePathFlag))
+        return name;
+
+    int start = name.size();
+    while (start > 0 && !isSeparator(name.at(start - 1)))
+        start--;
+
+    return name.mid(start);
+}
+
+/*!
+ * \brief Returns the native path of this item, taking it from the path cache if it's there.
+ *
+ * This is used for folders, whose paths are needed to build the paths of all their children.
+ */
+FileSystemItem::NativeString FileSystemItem::getFolderPath() const
+{
+    if (testFlag(AbsolutePathFlag))
+        return name;
+
+    PathCacheEntry &entry = pathCacheEntry(this);
+    quint32 generation = pathGeneration.load();
+
+    QMutexLocker locker(&pathCacheMutex);
+    if (entry.item.load() == this && entry.generation == generation)
+        return entry.path;
+    locker.unlock();
+
+    NativeString path = getNativePath();
+
+    // If a path changed meanwhile this entry is already stale and it will be replaced next time
+    locker.relock();
+    entry.item = this;
+    entry.generation = generation;
+    entry.path = path;
+
+    return path;
+}
+
+/*!
+ * \brief Stores the native path \a value.
+ *
+ * If \a value is right below the path of the parent only its last component is stored.  Otherwise, like for the
+ * root, drives or virtual folders, the whole path is.
+ */
+void FileSystemItem::assignPath(const NativeString &value)
+{
+    int start = (parent != nullptr) ? childNameStart(value, parent->getFolderPath()) : -1;
+
+    // A display name that was the name must be kept, the whole path isn't displayed
+    if (start < 0 && !testFlag(AbsolutePathFlag) && !testFlag(DisplayNameFlag) && !name.isNull()) {
+        displayName = getDisplayName();
+        setFlag(DisplayNameFlag, true);
+    }
+
+    NativeString newName = (start >= 0) ? value.mid(start) : value;
+
+    // The decoded name kept is the one of the old name
+    if (newName != name && !testFlag(DisplayNameFlag)) {
+        flags.fetch_and(~static_cast<quint32>(DecodedNameFlag | DecodingNameFlag), std::memory_order_relaxed);
+        displayName = QString();
+    }
+
+    name = newName;
+    setFlag(AbsolutePathFlag, start < 0);
+}
+
+bool FileSystemItem::hasSamePath(const FileSystemItem *item) const
+{
+    if (testFlag(AbsolutePathFlag) || item->testFlag(AbsolutePathFlag))
+        return getNativePath() == item->getNativePath();
+
+    return name == item->name && (parent == item->parent || parent->getFolderPath() == item->parent->getFolderPath());
+}
+
+/*!
+ * \brief Returns where the last component of \a path starts if \a path is right below \a folderPath, or -1.
+ */
+int FileSystemItem::childNameStart(const NativeString &path, const NativeString &folderPath)
+{
+    if (folderPath.isEmpty() || !path.startsWith(folderPath))
+        return -1;
+
+    int start = folderPath.size();
+    if (!isSeparator(folderPath.at(start - 1))) {
+        if (start >= path.size() || path.at(start) != nativeSeparator)
+            return -1;
+        start++;
+    }
+
+    if (start >= path.size())
+        return -1;
+
+    for (int i = start; i < path.size(); i++)
+        if (isSeparator(path.at(i)))
+            return -1;
+
+    return start;
+}
+
+FileSystemItem::NativeString FileSystemItem::toNative(const QString &value)
+{
+#ifdef Q_OS_WIN
+    return value;
+#else
+    return QFile::encodeName(value);
+#endif
+}
+
+QString FileSystemItem::fromNative(const NativeString &value)
+{
+#ifdef Q_OS_WIN
+    return value;
+#else
+    return QFile::decodeName(value);
+#endif
+}
+
+/*!
+ * \brief Removes the cached path of this item, so another item allocated at the same address doesn't get it.
+ */
+void FileSystemItem::forgetPath() const
+{
+    PathCacheEntry &entry = pathCacheEntry(this);
+    if (entry.item.load() != this)
+        return;
+
+    QMutexLocker locker(&pathCacheMutex);
+    if (entry.item.load() == this) {
+        entry.item = nullptr;
+        entry.path.clear();
+    }
 }
 
 QIcon FileSystemItem::getIcon() const
@@ -188,34 +956,49 @@ void FileSystemItem::setIcon(const QIcon &value)
 
 bool FileSystemItem::isFolder() const
 {
-    return folder;
+    return testFlag(FolderFlag);
 }
 
 void FileSystemItem::setFolder(bool value)
 {
-    folder = value;
-    if (folder)
+    setFlag(FolderFlag, value);
+    if (value)
         extension = QString();
 }
 
 bool FileSystemItem::isHidden() const
 {
-    return hidden;
+    return testFlag(HiddenFlag);
 }
 
 void FileSystemItem::setHidden(bool value)
 {
-    hidden = value;
+    setFlag(HiddenFlag, value);
+}
+
+bool FileSystemItem::isIndexed() const
+{
+    return testFlag(IndexedFlag);
+}
+
+/*!
+ * \brief Adds the children of this item to the NameIndex, and then their children and so on, as they're added.
+ *
+ * Only the root of a model is set, the items of temporary listings are not indexed.
+ */
+void FileSystemItem::setIndexed(bool value)
+{
+    setFlag(IndexedFlag, value);
 }
 
 bool FileSystemItem::hasFakeIcon() const
 {
-    return fakeIcon;
+    return testFlag(FakeIconFlag);
 }
 
 void FileSystemItem::setFakeIcon(bool value)
 {
-    fakeIcon = value;
+    setFlag(FakeIconFlag, value);
 }
 
 QString FileSystemItem::getType() const
@@ -225,7 +1008,7 @@ QString FileSystemItem::getType() const
 
 void FileSystemItem::setType(const QString &value)
 {
-    type = value;
+    type = intern(value);
 }
 
 quint64 FileSystemItem::getSize() const
@@ -243,90 +1026,161 @@ QString FileSystemItem::getExtension() const
     return extension;
 }
 
+/*!
+ * \brief Sets the extension to \a value, which should come from the FileTypeCache so it's shared.
+ */
+void FileSystemItem::setExtension(const QString &value)
+{
+    extension = value;
+}
+
 QDateTime FileSystemItem::getCreationTime() const
 {
-    return creationTime;
+    return toDateTime(creationTime);
 }
 
 void FileSystemItem::setCreationTime(const QDateTime &value)
 {
-    creationTime = value;
+    creationTime = fromDateTime(value);
 }
 
 QDateTime FileSystemItem::getLastAccessTime() const
 {
-    return lastAccessTime;
+    return toDateTime(lastAccessTime);
 }
 
 void FileSystemItem::setLastAccessTime(const QDateTime &value)
 {
-    lastAccessTime = value;
+    lastAccessTime = fromDateTime(value);
 }
 
 QDateTime FileSystemItem::getLastChangeTime() const
 {
-    return lastChangeTime;
+    return toDateTime(lastChangeTime);
 }
 
 void FileSystemItem::setLastChangeTime(const QDateTime &value)
+{
+    lastChangeTime = fromDateTime(value);
+}
+
+qint64 FileSystemItem::getCreationTimeNSecs() const
+{
+    return creationTime;
+}
+
+void FileSystemItem::setCreationTimeNSecs(qint64 value)
+{
+    creationTime = value;
+}
+
+qint64 FileSystemItem::getLastAccessTimeNSecs() const
+{
+    return lastAccessTime;
+}
+
+void FileSystemItem::setLastAccessTimeNSecs(qint64 value)
+{
+    lastAccessTime = value;
+}
+
+qint64 FileSystemItem::getLastChangeTimeNSecs() const
+{
+    return lastChangeTime;
+}
+
+void FileSystemItem::setLastChangeTimeNSecs(qint64 value)
 {
     lastChangeTime = value;
 }
 
 FileSystemItem *FileSystemItem::clone()
 {
-    FileSystemItem *item = new FileSystemItem(path);
+    FileSystemItem *item = testFlag(AbsolutePathFlag) ? new FileSystemItem(getPath(), parent) :
+                                                         new FileSystemItem(parent, name);
 
     cloneTo(item);
 
-    item->setParent(parent);
-
     return item;
 }
 
 void FileSystemItem::cloneTo(FileSystemItem *destination)
 {
-    destination->setDisplayName(displayName);
+    destination->setDisplayName(getDisplayName());
     destination->setIcon(icon);
     destination->setSize(size);
     destination->setType(type);
-    destination->setCreationTime(creationTime);
-    destination->setLastAccessTime(lastAccessTime);
-    destination->setLastChangeTime(lastChangeTime);
-    destination->setCapabilities(capabilities);
-    destination->setMediaType(mediaType);
-
-    destination->setFolder(folder);
-    destination->setHidden(hidden);
-    destination->setHasSubFolders(hasSubFolders);
-    destination->setAllChildrenFetched(allChildrenFetched);
-    destination->setFakeIcon(fakeIcon);
+    destination->setCreationTimeNSecs(creationTime);
+    destination->setLastAccessTimeNSecs(lastAccessTime);
+    destination->setLastChangeTimeNSecs(lastChangeTime);
+    destination->setCapabilities(getCapabilities());
+    destination->setMediaType(getMediaType());
+    destination->setMetadataState(getMetadataState());
+    destination->setSubFoldersState(getSubFoldersState());
+
+    destination->setFolder(isFolder());
+    destination->setHidden(isHidden());
+    destination->setHasSubFolders(getHasSubFolders());
+    destination->setAllChildrenFetched(areAllChildrenFetched());
+    destination->setFakeIcon(hasFakeIcon());
 }
 
 quint16 FileSystemItem::getCapabilities() const
 {
-    return capabilities;
+    return static_cast<quint16>(getState(CapabilitiesShift, 0xFF));
 }
 
 void FileSystemItem::setCapabilities(const quint16 &value)
 {
-    capabilities = value;
+    setState(CapabilitiesShift, 0xFF, value);
 }
 
 FileSystemItem::MediaType FileSystemItem::getMediaType() const
 {
-    return mediaType;
+    return static_cast<MediaType>(getState(MediaTypeShift, 0x0F));
 }
 
 void FileSystemItem::setMediaType(const MediaType &value)
 {
-    mediaType = value;
+    setState(MediaTypeShift, 0x0F, value);
+}
+
+FileSystemItem::MetadataState FileSystemItem::getMetadataState() const
+{
+    return static_cast<MetadataState>(getState(MetadataStateShift, 0x03));
+}
+
+void FileSystemItem::setMetadataState(const MetadataState &value)
+{
+    setState(MetadataStateShift, 0x03, value);
+}
+
+bool FileSystemItem::isMetadataComplete() const
+{
+    return getMetadataState() == MetadataComplete;
+}
+
+FileSystemItem::SubFoldersState FileSystemItem::getSubFoldersState() const
+{
+    return static_cast<SubFoldersState>(getState(SubFoldersStateShift, 0x03));
+}
+
+void FileSystemItem::setSubFoldersState(const SubFoldersState &value)
+{
+    setState(SubFoldersStateShift, 0x03, value);
 }
 
 void FileSystemItem::clear()
 {
-    indexedChildren.clear();
-    children.clear();
+    FolderData *data = folderData.load();
+    if (data != nullptr) {
+        data->indexedChildren.clear();
+        data->folders.clear();
+        data->children.clear();
+
+        if (testFlag(IndexedFlag))
+            NameIndex::remove(this);
+    }
     setAllChildrenFetched(false);
 }
 
@@ -342,22 +1196,24 @@ void FileSystemItem::setErrorCode(const qint32 &value)
 
 QString FileSystemItem::getErrorMessage() const
 {
-    return errorMessage;
+    FolderData *data = folderData.load();
+    return (data != nullptr) ? data->errorMessage : QString();
 }
 
 void FileSystemItem::setErrorMessage(const QString &value)
 {
-    errorMessage = value;
+    if (!value.isEmpty() || folderData.load() != nullptr)
+        getFolderData()->errorMessage = value;
 }
 
 bool FileSystemItem::getLock() const
 {
-    return lock;
+    return testFlag(LockFlag);
 }
 
 void FileSystemItem::setLock(bool value)
 {
-    lock = value;
+    setFlag(LockFlag, value);
 }
 
 QVariant FileSystemItem::getData(int column)
@@ -2,13 +2,18 @@
 #define FILESYSTEMITEM_H
 
 #include <QHash>
+#include <QVector>
 #include <QIcon>
 #include <QString>
+#include <QByteArray>
 #include <QVariant>
 #include <QDateTime>
 
+#include <atomic>
 #include <limits>
 
+#include "Shell/FileSystemItemArena.h"
+
 // Capabilities
 #define FSI_CAN_COPY    0x0001
 #define FSI_CAN_MOVE    0x0002
@@ -17,6 +22,39 @@
 #define FSI_CAN_DELETE  0x0010
 #define FSI_DROP_TARGET 0x0020
 
+/*!
+ * \brief An item of the filesystem, a file, a folder or a drive.
+ *
+ * The items are kept small since a fully expanded tree can have millions of them:
+ *
+ * - All the boolean flags and states are packed in a single word, that is updated atomically because the retriever
+ *   threads and the GUI thread may change different flags of the same item at the same time.
+ *
+ * - Dates are stored as nanoseconds since epoch, they're only turned into QDateTime objects when asked.
+ *
+ * - Types and extensions are shared by all the items that have the same ones. \sa intern \sa FileTypeCache
+ *
+ * - The children containers and the error message are only allocated for folders that have children or an error.
+ *
+ * - The items of a listing can be allocated together from a FileSystemItemArena. \sa operator new
+ *
+ * - Items only store their name, their path is built from the paths of their parents when asked.  Renaming a folder
+ *   doesn't touch its descendants. \sa getPath
+ *
+ * - Names are stored in the native encoding of the platform.  On Unix they're the bytes of the filesystem, so the
+ *   display name is only decoded when it's needed, and names that are not valid in the locale encoding still work.
+ *   \sa getNativePath
+ *
+ * - The collation key of the display name is made once, usually by the retriever threads. \sa getSortKey
+ *
+ * - The names of the descendants of an indexed item are kept in the NameIndex, for searches. \sa setIndexed
+ *
+ * - The children that are folders or drives are also kept in a list of their own, so the tree doesn't have to look at
+ *   the files. \sa FolderModel
+ *
+ * On 64 bit systems every item takes 120 bytes, including the arena it came from, plus its name, display name and
+ * collation key.
+ */
 class FileSystemItem
 {
 public:
@@ -39,22 +77,60 @@ public:
         RamDisk
     };
 
-    FileSystemItem(QString path);
+    // Size, dates and type of an item may be retrieved after the item is listed
+    enum MetadataState {
+        MetadataComplete,
+        MetadataPending,
+        MetadataRequested
+    };
+
+    // Whether a folder has subfolders may be found out after the folder is listed
+    enum SubFoldersState {
+        SubFoldersKnown,
+        SubFoldersPending,
+        SubFoldersRequested
+    };
+
+#ifdef Q_OS_WIN
+    typedef QString NativeString;
+#else
+    typedef QByteArray NativeString;
+#endif
+
+    FileSystemItem(QString path, FileSystemItem *parent = nullptr);
+    FileSystemItem(FileSystemItem *parent, const NativeString &name);
     ~FileSystemItem();
 
+    static void *operator new(size_t size);
+    static void *operator new(size_t size, FileSystemItemArena *arena);
+    static void operator delete(void *pointer);
+    static void operator delete(void *pointer, FileSystemItemArena *arena);
+
     QString getDisplayName() const;
     void setDisplayName(const QString &value);
 
+    const char *getSortKey() const;
+    void prepareSortKey() const;
+
     void addChild(FileSystemItem *child);
     FileSystemItem *getChildAt(int n);
     FileSystemItem *getChild(QString path);
     void removeChild(QString path);
     QList<FileSystemItem *> getChildren();
     void removeChildren();
+    QList<FileSystemItem *> takeChildren();
+    static void deleteItems(const QList<FileSystemItem *> &items);
     void updateChildPath(FileSystemItem *child, QString path);
 
     int childrenCount();
     int childRow(FileSystemItem *child);
+    int findChildRow(FileSystemItem *child);
+
+    int foldersCount();
+    FileSystemItem *getFolderAt(int n);
+    int folderRow(FileSystemItem *child);
+    int foldersBefore(int row);
+    bool updateFolder(FileSystemItem *child);
 
     void clear();
 
@@ -69,6 +145,7 @@ public:
 
     bool isDrive() const;
     bool isInADrive() const;
+    bool isFolderOrDrive() const;
     bool isEqualTo(FileSystemItem *item) const;
 
     QVariant getData(int column);
@@ -76,6 +153,9 @@ public:
     QString getPath() const;
     void setPath(const QString &value);
 
+    NativeString getNativePath() const;
+    NativeString getNativeName() const;
+
     QIcon getIcon() const;
     void setIcon(const QIcon &value);
 
@@ -85,6 +165,9 @@ public:
     bool isHidden() const;
     void setHidden(bool value);
 
+    bool isIndexed() const;
+    void setIndexed(bool value);
+
     bool hasFakeIcon() const;
     void setFakeIcon(bool value);
 
@@ -95,6 +178,7 @@ public:
     void setSize(const quint64 &value);
 
     QString getExtension() const;
+    void setExtension(const QString &value);
 
     QDateTime getCreationTime() const;
     void setCreationTime(const QDateTime &value);
@@ -105,6 +189,14 @@ public:
     QDateTime getLastChangeTime() const;
     void setLastChangeTime(const QDateTime &value);
 
+    // Dates as nanoseconds since epoch, or std::numeric_limits<qint64>::min() if unknown
+    qint64 getCreationTimeNSecs() const;
+    void setCreationTimeNSecs(qint64 value);
+    qint64 getLastAccessTimeNSecs() const;
+    void setLastAccessTimeNSecs(qint64 value);
+    qint64 getLastChangeTimeNSecs() const;
+    void setLastChangeTimeNSecs(qint64 value);
+
     FileSystemItem *clone();
     void cloneTo(FileSystemItem *destination);
 
@@ -114,6 +206,13 @@ public:
     MediaType getMediaType() const;
     void setMediaType(const MediaType &value);
 
+    MetadataState getMetadataState() const;
+    void setMetadataState(const MetadataState &value);
+    bool isMetadataComplete() const;
+
+    SubFoldersState getSubFoldersState() const;
+    void setSubFoldersState(const SubFoldersState &value);
+
     qint32 getErrorCode() const;
     void setErrorCode(const qint32 &value);
 
@@ -129,33 +228,95 @@ public:
 
 private:
 
-    QString     path                {};
-    QString     displayName         {};
+    enum Flag : quint32 {
+        FolderFlag              = 0x0001,
+        HiddenFlag              = 0x0002,
+        HasSubFoldersFlag       = 0x0004,
+        AllChildrenFetchedFlag  = 0x0008,
+        FakeIconFlag            = 0x0010,
+        LockFlag                = 0x0020,
+        AbsolutePathFlag        = 0x0040,       // The name is the whole path, see assignPath()
+        IndexedFlag             = 0x0080,       // The children are added to the NameIndex
+        DisplayNameFlag         = 0x01000000,   // The display name was set by setDisplayName()
+        DecodedNameFlag         = 0x02000000,   // The display name is the decoded name, see getDisplayName()
+        DecodingNameFlag        = 0x04000000    // A thread is decoding the name to keep it
+    };
+
+    // The states and the capabilities are stored in the flags too, shifted by these amounts
+    enum StateShift {
+        MetadataStateShift      = 8,
+        SubFoldersStateShift    = 10,
+        MediaTypeShift          = 12,
+        CapabilitiesShift       = 16            // 8 bits, the ones above are flags
+    };
+
+    // Open addressing hash table of the children.  Only their names are hashed, since they all share the same parent
+    class ChildrenIndex {
+    public:
+        FileSystemItem *find(const NativeString &path, int nameStart) const;
+        void insert(FileSystemItem *child);
+        void remove(FileSystemItem *child);
+        void clear();
+
+    private:
+        QVector<FileSystemItem *> table {};     // The size is always a power of two
+        int count                       {};
+        int tombstones                  {};
+
+        void place(FileSystemItem *child);
+        void rehash(int capacity);
+        static uint hash(const NativeString &path);
+    };
+
+    // Only folders with children or with an error need these
+    struct FolderData {
+        QList<FileSystemItem *> indexedChildren;
+        QVector<FileSystemItem *> folders;      // The children that are folders or drives, in the order of their rows.
+                                                // Only the FolderModel updates them
+        ChildrenIndex children;
+        QString errorMessage;
+    };
+
+    NativeString name               {};     // The last component of the path, or all of it
+    mutable QString displayName     {};     // Only valid with DisplayNameFlag or DecodedNameFlag
     QString     extension           {};
+    QString     type                {};
     QIcon       icon                {};
     quint64     size                { std::numeric_limits<quint64>::max() };
-    QString     type                {};
-    QDateTime   creationTime        {};
-    QDateTime   lastAccessTime      {};
-    QDateTime   lastChangeTime      {};
-    quint16     capabilities        {};
-    MediaType   mediaType           {};
-    qint32      errorCode           {};
-    QString     errorMessage        {};
+    qint64      creationTime        { std::numeric_limits<qint64>::min() };
+    qint64      lastAccessTime      { std::numeric_limits<qint64>::min() };
+    qint64      lastChangeTime      { std::numeric_limits<qint64>::min() };
+
+    FileSystemItem *parent          {};
+    std::atomic<FolderData *> folderData {};
+    mutable std::atomic<char *> sortKey {};     // Stamped collation key of the display name \sa Collation
+
+    std::atomic<quint32> flags      {};
     quint32     refCounter          {};
+    qint32      errorCode           {};
+    qint32      row                 { -1 };     // Row in the parent, so childRow() doesn't have to look for it
 
-    bool folder                     {};
-    bool hidden                     {};
-    bool hasSubFolders              {};
-    bool allChildrenFetched         {};
-    bool fakeIcon                   {};
-    bool lock                       {};
+    inline bool testFlag(Flag flag) const   { return flags.load(std::memory_order_relaxed) & flag; }
+    void setFlag(Flag flag, bool value);
+    quint32 getState(StateShift shift, quint32 mask) const;
+    void setState(StateShift shift, quint32 mask, quint32 value);
+    FolderData *getFolderData();
+    int findFolder(const FolderData *data, int row) const;
 
-    FileSystemItem *parent          {};
+    NativeString getFolderPath() const;
+    void assignPath(const NativeString &value);
+    bool hasSamePath(const FileSystemItem *item) const;
+    void forgetPath() const;
+
+    static int childNameStart(const NativeString &path, const NativeString &folderPath);
+    static NativeString toNative(const QString &value);
+    static QString fromNative(const NativeString &value);
+
+    static QString intern(const QString &value);
+    static QDateTime toDateTime(qint64 nsecs);
+    static qint64 fromDateTime(const QDateTime &dateTime);
 
-    // Children
-    QHash<QString, FileSystemItem *> children;
-    QList<FileSystemItem *> indexedChildren;
+    Q_DISABLE_COPY(FileSystemItem)
 };
 
 #endif // FILESYSTEMITEM_H
@@ -0,0 +1,50 @@
+#include "FileSystemItemArena.h"
+
+// The first block is small since most folders only have a few items, then every block doubles up to the maximum
+#define ARENA_FIRST_BLOCK_SIZE      (2 * 1024)
+#define ARENA_MAX_BLOCK_SIZE        (256 * 1024)
+
+// Every allocation is aligned to this
+#define ARENA_ALIGNMENT             alignof(std::max_align_t)
+
+FileSystemItemArena::FileSystemItemArena()
+{
+}
+
+FileSystemItemArena::~FileSystemItemArena()
+{
+    for (char *block : qAsConst(blocks))
+        delete[] block;
+}
+
+/*!
+ * \brief Returns \a size bytes of storage that are valid until the arena is released by everyone.
+ *
+ * Every allocation takes a reference to the arena, that is given back by release().
+ */
+void *FileSystemItemArena::allocate(size_t size)
+{
+    size = (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+
+    if (blocks.isEmpty() || used + size > blockSize) {
+        blockSize = blocks.isEmpty() ? ARENA_FIRST_BLOCK_SIZE : qMin<size_t>(blockSize * 2, ARENA_MAX_BLOCK_SIZE);
+        blockSize = qMax(blockSize, size);
+        blocks.append(new char[blockSize]);
+        used = 0;
+    }
+
+    void *pointer = blocks.last() + used;
+    used += size;
+
+    references.ref();
+    return pointer;
+}
+
+/*!
+ * \brief Gives back \a count references to the arena.  All the blocks are freed when the last one is gone.
+ */
+void FileSystemItemArena::release(int count)
+{
+    if (references.fetchAndSubOrdered(count) == count)
+        delete this;
+}
@@ -0,0 +1,45 @@
+#ifndef FILESYSTEMITEMARENA_H
+#define FILESYSTEMITEMARENA_H
+
+#include <QAtomicInt>
+#include <QVector>
+
+#include <cstddef>
+
+/*!
+ * \brief Storage for the items of one folder listing.
+ *
+ * The items of a listing are allocated from a few big blocks instead of one by one, and the blocks are freed all at
+ * once when the last of those items is deleted.  Removing or refreshing a huge folder then doesn't go through the
+ * allocator for every item.
+ *
+ * Items are created with new (arena) FileSystemItem(path) and deleted as usual. \sa FileSystemItem::operator new
+ *
+ * The arena keeps a reference for every item alive and one for its creator, that has to call release() when it's
+ * done allocating.  Items can be moved to another folder, they keep the arena they came from alive.
+ *
+ * Removing all the children of a folder gives back the references of the ones that came from the same arena at once.
+ * \sa FileSystemItem::removeChildren
+ *
+ * Only one thread can allocate from an arena at a time, but the items can be deleted from any thread.
+ */
+class FileSystemItemArena
+{
+public:
+    FileSystemItemArena();
+
+    void *allocate(size_t size);
+    void release(int count = 1);
+
+private:
+    QAtomicInt      references  { 1 };
+    QVector<char *> blocks      {};
+    size_t          blockSize   {};
+    size_t          used        {};
+
+    ~FileSystemItemArena();
+
+    Q_DISABLE_COPY(FileSystemItemArena)
+};
+
+#endif // FILESYSTEMITEMARENA_H
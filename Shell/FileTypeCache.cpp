@@ -0,0 +1,153 @@
+#include <QCoreApplication>
+#include <QReadWriteLock>
+#include <QMimeDatabase>
+#include <QStringList>
+#include <QFile>
+#include <QHash>
+#include <QSet>
+#include <QDebug>
+
+#include "FileTypeCache.h"
+
+// Maximum number of suffixes kept, the types of the rest are looked up every time
+#define FILE_TYPE_CACHE_MAX_ENTRIES 4096
+
+// A dot at this index or before doesn't start a suffix, so hidden files on Unix have no extension
+#ifdef Q_OS_WIN
+#define MIN_INDEX -1
+#else
+#define MIN_INDEX 0
+#endif
+
+namespace {
+
+QReadWriteLock lock;
+QHash<QString, FileTypeCache::FileType> fileTypes;
+
+/*!
+ * \brief Returns the last parts of all the compound suffixes known, like "gz" for "tar.gz".
+ */
+const QSet<QString> &compoundSuffixEnds()
+{
+    static const QSet<QString> ends = [] {
+        QSet<QString> result;
+        for (const QMimeType &mimeType : QMimeDatabase().allMimeTypes()) {
+            for (const QString &suffix : mimeType.suffixes()) {
+                int index = suffix.lastIndexOf('.');
+                if (index >= 0)
+                    result.insert(suffix.mid(index + 1));
+            }
+        }
+        return result;
+    }();
+
+    return ends;
+}
+
+QString toTitleCase(QString str)
+{
+    QString result;
+    QStringList strList = str.split(' ');
+    for (auto word : strList) {
+        if (!result.isEmpty())
+            result += ' ';
+        if (!word.isEmpty())
+            result += word.replace(0, 1, word.at(0).toUpper());
+    }
+    return result;
+}
+
+}
+
+/*!
+ * \brief Returns the type of the file named \a fileName.
+ */
+FileTypeCache::FileType FileTypeCache::lookup(const QString &fileName)
+{
+    QString fileTypeKey = key(fileName);
+
+    {
+        QReadLocker locker(&lock);
+        auto fileType = fileTypes.constFind(fileTypeKey);
+        if (fileType != fileTypes.cend())
+            return fileType.value();
+    }
+
+    FileType fileType = resolve(fileName);
+
+    QWriteLocker locker(&lock);
+    if (fileTypes.size() < FILE_TYPE_CACHE_MAX_ENTRIES)
+        fileTypes.insert(fileTypeKey, fileType);
+
+    return fileType;
+}
+
+/*!
+ * \brief Returns the type of the file named \a nativeFileName in the local 8 bit encoding.
+ *
+ * Only the last two suffixes of the name are decoded, since the rest doesn't change the type.  Names without a suffix
+ * are decoded whole.
+ */
+FileTypeCache::FileType FileTypeCache::lookup(const QByteArray &nativeFileName)
+{
+    int index = nativeFileName.lastIndexOf('.');
+    if (index <= MIN_INDEX)
+        return lookup(QFile::decodeName(nativeFileName));
+
+    int previous = nativeFileName.lastIndexOf('.', index - 1);
+    int start = (previous > MIN_INDEX) ? previous : index;
+
+    // Any name ending like this one has the same type
+    return lookup('_' + QFile::decodeName(nativeFileName.mid(start)));
+}
+
+/*!
+ * \brief Returns the key of the files that have the same type as \a fileName.
+ *
+ * Whole names start with a '/', which no file name has, so they're never mistaken for suffixes.
+ */
+QString FileTypeCache::key(const QString &fileName)
+{
+    int index = fileName.lastIndexOf('.');
+    if (index <= MIN_INDEX)
+        return '/' + fileName;
+
+    if (compoundSuffixEnds().contains(fileName.mid(index + 1))) {
+        int previous = fileName.lastIndexOf('.', index - 1);
+        if (previous > MIN_INDEX)
+            return fileName.mid(previous + 1);
+    }
+
+    return fileName.mid(index + 1);
+}
+
+FileTypeCache::FileType FileTypeCache::resolve(const QString &fileName)
+{
+    QMimeDatabase mimeDatabase;
+    FileType fileType;
+
+    try {
+        fileType.extension = mimeDatabase.suffixForFileName(fileName);
+    }  catch (const std::exception& e) {
+        qDebug() << "FileTypeCache::resolve exception" << e.what();
+    }
+
+    if (fileType.extension.isEmpty()) {
+        int index = fileName.lastIndexOf('.');
+        fileType.extension = (index > MIN_INDEX) ? fileName.mid(index + 1) : QString();
+    }
+
+    QList<QMimeType> mimeList = mimeDatabase.mimeTypesForFileName(fileName);
+    if (mimeList.size() > 0) {
+        fileType.mimeType = mimeList.at(0).name();
+        fileType.description = toTitleCase(mimeList.at(0).comment());
+    } else {
+        QString strType;
+        if (!fileType.extension.isEmpty())
+            strType = fileType.extension.toUpper() + ' ';
+
+        fileType.description = strType + QCoreApplication::translate("FileTypeCache", "File");
+    }
+
+    return fileType;
+}
@@ -0,0 +1,37 @@
+#ifndef FILETYPECACHE_H
+#define FILETYPECACHE_H
+
+#include <QByteArray>
+#include <QString>
+
+/*!
+ * \brief A process wide cache of the types of the files, keyed by their suffixes.
+ *
+ * Looking up a name in QMimeDatabase goes through all the glob patterns of the system, while most of the files of a
+ * folder share a handful of suffixes.  The extension, MIME type and description of every suffix are worked out once,
+ * so the type of every other file with the same suffix costs a single hash lookup.
+ *
+ * Suffixes that are the end of a compound suffix, like "gz" in "tar.gz", are keyed by their last two parts instead.
+ * Names without a suffix are keyed by the whole name, since patterns like "Makefile" match whole names.
+ *
+ * The cache can be used from any thread.
+ */
+class FileTypeCache
+{
+public:
+
+    struct FileType {
+        QString extension;      // What the Extension column shows, empty if there's none
+        QString mimeType;       // The name of the MIME type, empty if it's not known
+        QString description;    // The localized description of the type, like "PNG Image"
+    };
+
+    static FileType lookup(const QString &fileName);
+    static FileType lookup(const QByteArray &nativeFileName);
+
+private:
+    static QString key(const QString &fileName);
+    static FileType resolve(const QString &fileName);
+};
+
+#endif // FILETYPECACHE_H
@@ -0,0 +1,369 @@
+#include <QtConcurrent/QtConcurrentRun>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QStandardPaths>
+#include <QSaveFile>
+#include <QFileInfo>
+#include <QFile>
+#include <QHash>
+#include <QDir>
+#include <QDebug>
+
+#include <cstring>
+
+#ifdef Q_OS_UNIX
+#include <sys/stat.h>
+#endif
+
+#include "ListingCache.h"
+
+#include "Shell/FileTypeCache.h"
+
+// Increase this every time the layout of the files changes, older files are ignored
+#define LISTING_CACHE_VERSION       4
+
+// Number of folders kept in the cache, the least recently saved ones are removed first
+#define LISTING_CACHE_MAX_FILES     256
+
+#define LISTING_CACHE_SUFFIX        ".cache"
+
+// A folder modified less than this before it was saved might be modified again without changing its modification time
+#define LISTING_CACHE_SETTLE_NSECS  2'000'000'000LL
+
+#define NSECS_PER_SEC               1'000'000'000LL
+#define NSECS_PER_MSEC              1'000'000LL
+
+namespace {
+
+const char magic[8] = { 'Y', 'X', 'L', 'I', 'S', 'T', 'N', 'G' };
+
+enum EntryFlags : quint16 {
+    FolderFlag          = 0x01,
+    HiddenFlag          = 0x02,
+    HasSubFoldersFlag   = 0x04,
+    SubFoldersKnownFlag = 0x08
+};
+
+// A file is a Header, followed by an Entry for every child, followed by the string table.
+// All the strings are UTF-16 and their offsets and lengths are in UTF-16 units.  The path of the folder is the first
+// string of the table.  The names are stored in the native encoding, see storedName().
+struct Header {
+    char        magic[8];
+    quint32     version;
+    quint32     count;              // Number of entries
+    qint64      modifiedTime;       // Of the folder when its children were saved, nsecs since epoch
+    qint64      savedTime;          // When the children were saved, nsecs since epoch
+    quint64     inode;              // Of the folder, 0 if the platform doesn't have inodes
+    quint32     pathLength;
+    quint32     stringsLength;
+};
+
+struct Entry {
+    quint64     size;
+    qint64      creationTime;       // All the times in nsecs since epoch, or std::numeric_limits<qint64>::min()
+    qint64      lastAccessTime;
+    qint64      lastChangeTime;
+    quint32     nameOffset;
+    quint32     nameLength;
+    quint32     displayNameOffset;
+    quint32     displayNameLength;  // 0 if the display name is the decoded name
+    quint32     typeOffset;
+    quint32     typeLength;
+    quint16     capabilities;
+    quint16     flags;
+    quint32     reserved;
+};
+
+/*!
+ * \brief Returns the native name \a name as a string of the table.
+ *
+ * On Unix every byte of the name is stored as a character, so names that are not valid in the locale encoding come
+ * back exactly as they were. \sa nativeName
+ */
+QString storedName(const FileSystemItem::NativeString &name)
+{
+#ifdef Q_OS_WIN
+    return name;
+#else
+    return QString::fromLatin1(name);
+#endif
+}
+
+FileSystemItem::NativeString nativeName(const QChar *string, int length)
+{
+#ifdef Q_OS_WIN
+    return QString(string, length);
+#else
+    return QString::fromRawData(string, length).toLatin1();
+#endif
+}
+
+QString decodedName(const FileSystemItem::NativeString &name)
+{
+#ifdef Q_OS_WIN
+    return name;
+#else
+    return QFile::decodeName(name);
+#endif
+}
+
+}
+
+ListingCache::ListingCache()
+{
+    QString location = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    if (!location.isEmpty())
+        directory = location + "/listings";
+}
+
+/*!
+ * \brief Creates the cached children of \a parent.
+ * \param parent a FileSystemItem folder.
+ * \param children the list where the new children are appended.  The caller owns them.
+ * \param modified set to false if the folder hasn't been modified since it was saved, so it has the same children.
+ * \return true if there was a valid entry for \a parent.
+ *
+ * The children have their metadata complete and no icon.
+ */
+bool ListingCache::load(FileSystemItem *parent, QList<FileSystemItem *> &children, bool &modified) const
+{
+    if (directory.isEmpty())
+        return false;
+
+    QFile file(fileName(parent->getPath()));
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    qint64 fileSize = file.size();
+    if (fileSize < static_cast<qint64>(sizeof(Header)))
+        return false;
+
+    const uchar *data = file.map(0, fileSize);
+    if (data == nullptr)
+        return false;
+
+    const Header *header = reinterpret_cast<const Header *>(data);
+    qint64 expectedSize = sizeof(Header) + sizeof(Entry) * static_cast<qint64>(header->count) +
+                          sizeof(QChar) * static_cast<qint64>(header->stringsLength);
+
+    if (memcmp(header->magic, magic, sizeof(magic)) != 0 || header->version != LISTING_CACHE_VERSION ||
+            expectedSize != fileSize || header->pathLength > header->stringsLength) {
+        qDebug() << "ListingCache::load invalid entry for" << parent->getPath();
+        return false;
+    }
+
+    const Entry *entries = reinterpret_cast<const Entry *>(data + sizeof(Header));
+    const QChar *strings = reinterpret_cast<const QChar *>(data + sizeof(Header) + sizeof(Entry) * header->count);
+
+    // Two paths with the same hash
+    if (QString::fromRawData(strings, static_cast<int>(header->pathLength)) != parent->getPath())
+        return false;
+
+    // A different folder with the same path, nothing in this entry is useful
+    qint64 modifiedTime;
+    quint64 inode;
+    if (!stamp(parent->getPath(), modifiedTime, inode) || inode != header->inode) {
+        qDebug() << "ListingCache::load discarding entry for" << parent->getPath();
+        file.close();
+        remove(parent->getPath());
+        return false;
+    }
+
+    // Most of the children share a few types, so share their strings too
+    QHash<quint32, QString> types;
+
+    // The children are freed together, like the ones of a real listing
+    FileSystemItemArena *arena = new FileSystemItemArena();
+
+    for (quint32 i = 0; i < header->count; i++) {
+
+        const Entry &entry = entries[i];
+        if (quint64(entry.nameOffset) + entry.nameLength > header->stringsLength ||
+                quint64(entry.displayNameOffset) + entry.displayNameLength > header->stringsLength ||
+                quint64(entry.typeOffset) + entry.typeLength > header->stringsLength) {
+            qDebug() << "ListingCache::load corrupted entry for" << parent->getPath();
+            qDeleteAll(children);
+            children.clear();
+            arena->release();
+            return false;
+        }
+
+        FileSystemItem::NativeString name = nativeName(strings + entry.nameOffset, static_cast<int>(entry.nameLength));
+
+        auto type = types.find(entry.typeOffset);
+        if (type == types.end())
+            type = types.insert(entry.typeOffset, QString(strings + entry.typeOffset, static_cast<int>(entry.typeLength)));
+
+        FileSystemItem *child = new (arena) FileSystemItem(parent, name);
+        child->setFolder(entry.flags & FolderFlag);
+
+        // Names that are displayed as they are are decoded when needed
+        if (entry.displayNameLength > 0)
+            child->setDisplayName(QString(strings + entry.displayNameOffset, static_cast<int>(entry.displayNameLength)));
+        else if (!child->isFolder())
+            child->setExtension(FileTypeCache::lookup(name).extension);
+        child->setHidden(entry.flags & HiddenFlag);
+        child->setType(type.value());
+        child->setSize(entry.size);
+        child->setCreationTimeNSecs(entry.creationTime);
+        child->setLastAccessTimeNSecs(entry.lastAccessTime);
+        child->setLastChangeTimeNSecs(entry.lastChangeTime);
+        child->setCapabilities(entry.capabilities);
+        child->setHasSubFolders(entry.flags & HasSubFoldersFlag);
+        child->setSubFoldersState((entry.flags & SubFoldersKnownFlag) ? FileSystemItem::SubFoldersKnown :
+                                                                        FileSystemItem::SubFoldersPending);
+        children.append(child);
+    }
+
+    arena->release();
+
+    modified = modifiedTime != header->modifiedTime || header->savedTime - header->modifiedTime < LISTING_CACHE_SETTLE_NSECS;
+
+    qDebug() << "ListingCache::load" << children.size() << "children of" << parent->getPath()
+             << (modified ? "(stale)" : "");
+
+    return true;
+}
+
+/*!
+ * \brief Saves the children of \a parent.
+ * \param parent a FileSystemItem folder with all its children fetched.
+ *
+ * A copy of the children is taken right away, along with the modification time of the folder, and the file is written
+ * in the background.
+ */
+void ListingCache::save(FileSystemItem *parent) const
+{
+    if (directory.isEmpty() || parent->getErrorCode() || !parent->areAllChildrenFetched())
+        return;
+
+    QList<FileSystemItem *> children = parent->getChildren();
+    if (children.isEmpty())
+        return;
+
+    QString path = parent->getPath();
+    QString strings = path;
+    QHash<QString, quint32> typeOffsets;
+
+    QByteArray data(static_cast<int>(sizeof(Header) + sizeof(Entry) * children.size()), '\0');
+
+    // The children are the ones of the folder as it is now, a later modification must not look older than them
+    Header *header = reinterpret_cast<Header *>(data.data());
+    if (!stamp(path, header->modifiedTime, header->inode))
+        return;
+
+    header->savedTime = QDateTime::currentMSecsSinceEpoch() * NSECS_PER_MSEC;
+    memcpy(header->magic, magic, sizeof(magic));
+    header->version = LISTING_CACHE_VERSION;
+    header->count = static_cast<quint32>(children.size());
+    header->pathLength = static_cast<quint32>(path.size());
+
+    Entry *entry = reinterpret_cast<Entry *>(data.data() + sizeof(Header));
+
+    for (FileSystemItem *child : children) {
+
+        QString type = child->getType();
+        auto typeOffset = typeOffsets.find(type);
+        if (typeOffset == typeOffsets.end()) {
+            typeOffset = typeOffsets.insert(type, static_cast<quint32>(strings.size()));
+            strings.append(type);
+        }
+
+        // Children that store a whole path, like drives, can't be made again from their names
+        FileSystemItem::NativeString name = child->getNativeName();
+        if (name.isEmpty())
+            return;
+
+        entry->nameOffset = static_cast<quint32>(strings.size());
+        entry->nameLength = static_cast<quint32>(name.size());
+        strings.append(storedName(name));
+
+        QString displayName = child->getDisplayName();
+        entry->displayNameOffset = static_cast<quint32>(strings.size());
+        if (displayName != decodedName(name)) {
+            entry->displayNameLength = static_cast<quint32>(displayName.size());
+            strings.append(displayName);
+        }
+
+        entry->typeOffset = typeOffset.value();
+        entry->typeLength = static_cast<quint32>(type.size());
+        entry->size = child->getSize();
+        entry->creationTime = child->getCreationTimeNSecs();
+        entry->lastAccessTime = child->getLastAccessTimeNSecs();
+        entry->lastChangeTime = child->getLastChangeTimeNSecs();
+        entry->capabilities = child->getCapabilities();
+        entry->flags = static_cast<quint16>((child->isFolder() ? FolderFlag : 0) |
+                                            (child->isHidden() ? HiddenFlag : 0) |
+                                            (child->getHasSubFolders() ? HasSubFoldersFlag : 0) |
+                                            (child->getSubFoldersState() == FileSystemItem::SubFoldersKnown ? SubFoldersKnownFlag : 0));
+        entry++;
+    }
+
+    header->stringsLength = static_cast<quint32>(strings.size());
+    data.append(reinterpret_cast<const char *>(strings.constData()), strings.size() * static_cast<int>(sizeof(QChar)));
+
+    QtConcurrent::run(&ListingCache::write, directory, fileName(path), data);
+}
+
+/*!
+ * \brief Removes the entry of the folder \a path, if any.
+ */
+void ListingCache::remove(const QString &path) const
+{
+    if (!directory.isEmpty())
+        QFile::remove(fileName(path));
+}
+
+QString ListingCache::fileName(const QString &path) const
+{
+    QByteArray hash = QCryptographicHash::hash(path.toUtf8(), QCryptographicHash::Sha1).toHex();
+    return directory + "/" + QString::fromLatin1(hash) + LISTING_CACHE_SUFFIX;
+}
+
+/*!
+ * \brief Gets the modification time in nsecs since epoch and the inode of the folder \a path.
+ * \return false if the folder can't be accessed.
+ */
+bool ListingCache::stamp(const QString &path, qint64 &modifiedTime, quint64 &inode)
+{
+#ifdef Q_OS_UNIX
+    struct stat buffer;
+    if (::stat(QFile::encodeName(path).constData(), &buffer) != 0)
+        return false;
+
+#ifdef Q_OS_DARWIN
+    modifiedTime = buffer.st_mtimespec.tv_sec * NSECS_PER_SEC + buffer.st_mtimespec.tv_nsec;
+#else
+    modifiedTime = buffer.st_mtim.tv_sec * NSECS_PER_SEC + buffer.st_mtim.tv_nsec;
+#endif
+    inode = static_cast<quint64>(buffer.st_ino);
+#else
+    QFileInfo fileInfo(path);
+    if (!fileInfo.exists())
+        return false;
+
+    modifiedTime = fileInfo.lastModified().toMSecsSinceEpoch() * NSECS_PER_MSEC;
+    inode = 0;
+#endif
+
+    return true;
+}
+
+/*!
+ * \brief Writes an entry and removes the oldest ones.  This runs in a background thread.
+ */
+void ListingCache::write(QString directory, QString fileName, QByteArray data)
+{
+    if (!QDir().mkpath(directory))
+        return;
+
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size() || !file.commit()) {
+        qDebug() << "ListingCache::write cannot write" << fileName << file.errorString();
+        return;
+    }
+
+    QFileInfoList entries = QDir(directory).entryInfoList(QStringList() << "*" LISTING_CACHE_SUFFIX, QDir::Files, QDir::Time);
+    for (int i = LISTING_CACHE_MAX_FILES; i < entries.size(); i++)
+        QFile::remove(entries.at(i).absoluteFilePath());
+}
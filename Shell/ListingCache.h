@@ -0,0 +1,43 @@
+#ifndef LISTINGCACHE_H
+#define LISTINGCACHE_H
+
+#include <QString>
+#include <QList>
+
+#include "Shell/FileSystemItem.h"
+
+/*!
+ * \brief An on-disk cache of folder listings.
+ *
+ * Every cached folder is a single file with the name, type, size, dates and flags of all its children, so a folder
+ * can be shown right away at startup before the filesystem is read again.
+ *
+ * Entries are keyed by the path of the folder, and they also store the modification time and the inode of the folder
+ * when its children were saved.  An entry of a folder that has been replaced by another one with the same path is
+ * discarded.  If the folder hasn't been modified since, it still has the same children, and only their size and dates
+ * may be out of date.
+ *
+ * The files are memory mapped when loaded, and written in the background with an atomic rename, so a crash never
+ * leaves a half written entry behind.  Only the most recently saved folders are kept.
+ *
+ * The cache is never trusted: callers are expected to read the folder again and apply the differences, or at least the
+ * metadata of the children when the folder hasn't been modified.
+ */
+class ListingCache
+{
+public:
+    ListingCache();
+
+    bool load(FileSystemItem *parent, QList<FileSystemItem *> &children, bool &modified) const;
+    void save(FileSystemItem *parent) const;
+    void remove(const QString &path) const;
+
+private:
+    QString directory;
+
+    QString fileName(const QString &path) const;
+    static bool stamp(const QString &path, qint64 &modifiedTime, quint64 &inode);
+    static void write(QString directory, QString fileName, QByteArray data);
+};
+
+#endif // LISTINGCACHE_H
@@ -0,0 +1,233 @@
+#include <QtConcurrent/QtConcurrentRun>
+#include <QFuture>
+#include <QThread>
+#include <QMutex>
+#include <QHash>
+#include <QPair>
+#include <QTime>
+#include <QDebug>
+
+#include <algorithm>
+
+#include "NameIndex.h"
+#include "FileSystemItem.h"
+
+// Searches of fewer characters than this are not worth splitting between the cores
+#define NAME_INDEX_PARALLEL_CHARS   65536
+
+namespace {
+
+struct Block {
+    QString names;          // The case folded display names of the children, each one followed by a zero
+    int count       {};     // Number of names
+    bool stale      {};     // The children changed, the block is made again before searching it
+};
+
+QMutex mutex;
+QHash<FileSystemItem *, Block> blocks;
+
+inline bool isBoundary(ushort character)
+{
+    return character == ' ' || character == '_' || character == '-' || character == '.' || character == '(' ||
+           character == '[';
+}
+
+// For heaps that keep the best matches, with the worst one on top
+inline bool isBetter(const NameIndex::Match &left, const NameIndex::Match &right)
+{
+    return left.score > right.score;
+}
+
+}
+
+/*!
+ * \brief Adds the name of \a child, just added to \a folder.
+ *
+ * The name is only added if the block of \a folder was made already and \a child is its last row.  Otherwise the
+ * block is made on the next search.
+ */
+void NameIndex::add(FileSystemItem *folder, FileSystemItem *child)
+{
+    QMutexLocker locker(&mutex);
+
+    auto block = blocks.find(folder);
+    if (block == blocks.end()) {
+        blocks.insert(folder, Block { QString(), 0, true });
+        return;
+    }
+
+    if (block->stale)
+        return;
+
+    if (folder->childRow(child) != block->count) {
+        block->stale = true;
+        return;
+    }
+
+    block->names.append(child->getDisplayName().toCaseFolded());
+    block->names.append(QChar());
+    block->count++;
+}
+
+/*!
+ * \brief Makes the block of \a folder again on the next search, because a child was removed or renamed.
+ */
+void NameIndex::invalidate(FileSystemItem *folder)
+{
+    QMutexLocker locker(&mutex);
+
+    auto block = blocks.find(folder);
+    if (block != blocks.end())
+        block->stale = true;
+}
+
+/*!
+ * \brief Forgets all the children of \a folder, because they're gone.
+ */
+void NameIndex::remove(FileSystemItem *folder)
+{
+    QMutexLocker locker(&mutex);
+    blocks.remove(folder);
+}
+
+/*!
+ * \brief Returns the best \a limit items whose names have all the characters of \a query in the same order.
+ *
+ * The best matches come first.  Matches at the start of the name or of a word, and characters matched one after the
+ * other, score higher.  Among the names that match as well, the shorter ones come first.
+ */
+QVector<NameIndex::Match> NameIndex::search(const QString &query, int limit)
+{
+    QString folded = query.toCaseFolded();
+    if (folded.isEmpty() || limit <= 0)
+        return QVector<Match>();
+
+    QTime start;
+    start.start();
+
+    QMutexLocker locker(&mutex);
+
+    QVector<QPair<FileSystemItem *, const Block *>> work;
+    qint64 total = 0;
+
+    for (auto block = blocks.begin(); block != blocks.end(); ++block) {
+
+        FileSystemItem *folder = block.key();
+        int count = folder->childrenCount();
+
+        if (block->stale || block->count != count) {
+            block->names.clear();
+            for (int row = 0; row < count; row++) {
+                block->names.append(folder->getChildAt(row)->getDisplayName().toCaseFolded());
+                block->names.append(QChar());
+            }
+            block->count = count;
+            block->stale = false;
+        }
+
+        if (count > 0) {
+            work.append(qMakePair(folder, &block.value()));
+            total += block->names.size();
+        }
+    }
+
+    const ushort *needle = folded.utf16();
+    int length = folded.size();
+
+    auto searchBlocks = [&work, needle, length, limit](int first, int last) {
+        QVector<Match> matches;
+
+        for (int i = first; i < last; i++) {
+
+            FileSystemItem *folder = work.at(i).first;
+            const QString &names = work.at(i).second->names;
+
+            const ushort *p = names.utf16();
+            const ushort *end = p + names.size();
+            const ushort *name = p;
+            int row = 0;
+            int matched = 0;
+
+            for (; p < end; p++) {
+                if (*p == 0) {
+                    if (matched == length) {
+                        Match match { folder->getChildAt(row), score(name, static_cast<int>(p - name), needle, length) };
+                        if (matches.size() < limit) {
+                            matches.append(match);
+                            std::push_heap(matches.begin(), matches.end(), isBetter);
+                        } else if (match.score > matches.first().score) {
+                            std::pop_heap(matches.begin(), matches.end(), isBetter);
+                            matches.last() = match;
+                            std::push_heap(matches.begin(), matches.end(), isBetter);
+                        }
+                    }
+                    row++;
+                    matched = 0;
+                    name = p + 1;
+                } else if (matched < length && *p == needle[matched])
+                    matched++;
+            }
+        }
+
+        return matches;
+    };
+
+    // Split the blocks in parts with about the same number of characters
+    int parts = (total < NAME_INDEX_PARALLEL_CHARS) ? 1 : qMax(1, QThread::idealThreadCount());
+    qint64 partSize = total / parts + 1;
+
+    QList<QFuture<QVector<Match>>> futures;
+    int first = 0;
+    qint64 size = 0;
+    for (int i = 0; i < work.size(); i++) {
+        size += work.at(i).second->names.size();
+        if (size >= partSize || i == work.size() - 1) {
+            int last = i + 1;
+            futures.append(QtConcurrent::run([&searchBlocks, first, last]() { return searchBlocks(first, last); }));
+            first = i + 1;
+            size = 0;
+        }
+    }
+
+    QVector<Match> matches;
+    for (QFuture<QVector<Match>> &future : futures)
+        matches += future.result();
+
+    std::stable_sort(matches.begin(), matches.end(), isBetter);
+    if (matches.size() > limit)
+        matches.resize(limit);
+
+    qDebug() << "NameIndex::search" << query << "found" << matches.size() << "items in" << total << "characters in"
+             << start.elapsed() << "milliseconds";
+
+    return matches;
+}
+
+/*!
+ * \brief Scores the match of \a query in \a name, both case folded.  \a name must have all the characters of \a query.
+ */
+int NameIndex::score(const ushort *name, int length, const ushort *query, int queryLength)
+{
+    int result = 0;
+    int previous = -2;
+    int matched = 0;
+
+    for (int i = 0; i < length && matched < queryLength; i++) {
+        if (name[i] != query[matched])
+            continue;
+
+        int bonus = 1;
+        if (i == previous + 1)
+            bonus += 4;
+        if (i == 0)
+            bonus += 8;
+        else if (isBoundary(name[i - 1]))
+            bonus += 4;
+
+        result += bonus;
+        previous = i;
+        matched++;
+    }
+
+    return result * 256 - qMin(length, 255);
+}
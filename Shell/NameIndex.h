@@ -0,0 +1,42 @@
+#ifndef NAMEINDEX_H
+#define NAMEINDEX_H
+
+#include <QString>
+#include <QVector>
+
+class FileSystemItem;
+
+/*!
+ * \brief A process wide index of the names of all the items loaded, for fuzzy searches.
+ *
+ * Every indexed folder has a block with the case folded display names of its children, in the order of their rows and
+ * separated by zeros.  The blocks are kept up to date by FileSystemItem::addChild(), which appends the name of the new
+ * child, and by the functions that remove or rename children, which mark the block to be made again.  Blocks are made
+ * the first time they're searched, so listing a folder costs almost nothing until the index is used.
+ *
+ * A search walks every block once, looking for the characters of the query in order, and scores only the names that
+ * have all of them.  The blocks are split between all the cores.
+ *
+ * The index can be updated from any thread, but it must be searched from the GUI thread, since the items found are
+ * only valid until the event loop runs again.
+ */
+class NameIndex
+{
+public:
+
+    struct Match {
+        FileSystemItem *item;
+        int score;
+    };
+
+    static void add(FileSystemItem *folder, FileSystemItem *child);
+    static void invalidate(FileSystemItem *folder);
+    static void remove(FileSystemItem *folder);
+
+    static QVector<Match> search(const QString &query, int limit);
+
+private:
+    static int score(const ushort *name, int length, const ushort *query, int queryLength);
+};
+
+#endif // NAMEINDEX_H
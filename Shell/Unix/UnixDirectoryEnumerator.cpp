@@ -0,0 +1,339 @@
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+
+#include "UnixDirectoryEnumerator.h"
+
+#ifdef Q_OS_LINUX
+#include <sys/syscall.h>
+#include <sys/vfs.h>
+#endif
+
+// Size of the buffer used to read entries with getdents64()
+// Every entry takes around 24 bytes plus its name, so this reads a few thousand entries at once
+#define ENUMERATOR_BUFFER_SIZE      (256 * 1024)
+
+#define NSECS_PER_SEC               1'000'000'000LL
+
+#ifdef Q_OS_LINUX
+// Filesystems where the link count of a folder is 2 plus the number of its subfolders
+// These values are from linux/magic.h
+#define EXT4_SUPER_MAGIC            0xEF53
+#define XFS_SUPER_MAGIC             0x58465342
+#define TMPFS_MAGIC                 0x01021994
+#define JFS_SUPER_MAGIC             0x3153464a
+#define REISERFS_SUPER_MAGIC        0x52654973
+#define F2FS_SUPER_MAGIC            0xF2F52010
+#endif
+
+#ifdef Q_OS_LINUX
+// Not every libc exports getdents64() or its structure, so we use our own
+struct linux_dirent64 {
+    quint64         d_ino;
+    qint64          d_off;
+    unsigned short  d_reclen;
+    unsigned char   d_type;
+    char            d_name[];
+};
+#endif
+
+/*!
+ * \brief Opens the directory \a path for enumeration.
+ * \param path an absolute path in the native encoding.
+ */
+UnixDirectoryEnumerator::UnixDirectoryEnumerator(const char *path)
+{
+    open(AT_FDCWD, path);
+}
+
+/*!
+ * \brief Opens the directory \a name relative to the directory file descriptor \a parentFd.
+ * \param parentFd a file descriptor of an open directory.
+ * \param name the name of the directory in the native encoding.
+ *
+ * This is the fastest way to open a subdirectory while enumerating its parent.
+ */
+UnixDirectoryEnumerator::UnixDirectoryEnumerator(int parentFd, const char *name)
+{
+    open(parentFd, name);
+}
+
+UnixDirectoryEnumerator::~UnixDirectoryEnumerator()
+{
+#ifdef Q_OS_LINUX
+    free(buffer);
+
+    if (dirFd >= 0)
+        ::close(dirFd);
+#else
+    // closedir() also closes dirFd
+    if (dir != nullptr)
+        ::closedir(dir);
+    else if (dirFd >= 0)
+        ::close(dirFd);
+#endif
+}
+
+void UnixDirectoryEnumerator::open(int parentFd, const char *name)
+{
+    dirFd = ::openat(parentFd, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+    if (dirFd < 0) {
+        errorCode = errno;
+        return;
+    }
+
+#ifdef Q_OS_LINUX
+    buffer = static_cast<char *>(malloc(ENUMERATOR_BUFFER_SIZE));
+    if (buffer == nullptr) {
+        errorCode = ENOMEM;
+        ::close(dirFd);
+        dirFd = -1;
+    }
+#else
+    // fdopendir() takes ownership of the descriptor, so we give it a copy and keep ours for fstatat()
+    int fd = ::dup(dirFd);
+    if (fd < 0 || (dir = ::fdopendir(fd)) == nullptr) {
+        errorCode = errno;
+        if (fd >= 0)
+            ::close(fd);
+        ::close(dirFd);
+        dirFd = -1;
+    }
+#endif
+}
+
+bool UnixDirectoryEnumerator::isOpen() const
+{
+    return dirFd >= 0;
+}
+
+/*!
+ * \brief Returns the errno value of the last failed operation, or 0 if there was no error.
+ */
+int UnixDirectoryEnumerator::error() const
+{
+    return errorCode;
+}
+
+/*!
+ * \brief Returns the file descriptor of the directory being enumerated.
+ *
+ * The file descriptor is owned by this object and it's valid until this object is destroyed.
+ */
+int UnixDirectoryEnumerator::fd() const
+{
+    return dirFd;
+}
+
+/*!
+ * \brief Reads the next entry of the directory.
+ * \param entry an Entry object that will be filled with the next entry.
+ * \return true if an entry was read, false if there are no more entries or an error occurred.
+ *
+ * The entries "." and ".." are skipped.  The name of the entry points to an internal buffer that
+ * is only valid until the next call to this function.
+ *
+ * If this function returns false, error() will return a non zero value only if there was an error.
+ */
+bool UnixDirectoryEnumerator::next(Entry &entry)
+{
+    if (dirFd < 0)
+        return false;
+
+#ifdef Q_OS_LINUX
+    forever {
+
+        if (bufferPos >= bufferEnd) {
+
+            long read = ::syscall(SYS_getdents64, dirFd, buffer, ENUMERATOR_BUFFER_SIZE);
+
+            if (read <= 0) {
+                if (read < 0)
+                    errorCode = errno;
+                return false;
+            }
+
+            bufferPos = 0;
+            bufferEnd = read;
+        }
+
+        linux_dirent64 *dirent = reinterpret_cast<linux_dirent64 *>(buffer + bufferPos);
+        bufferPos += dirent->d_reclen;
+
+        const char *name = dirent->d_name;
+        if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+            continue;
+
+        entry.name = name;
+        entry.nameLength = static_cast<int>(strlen(name));
+        entry.type = dirent->d_type;
+        entry.inode = dirent->d_ino;
+        return true;
+    }
+#else
+    forever {
+
+        errno = 0;
+        struct dirent *dirent = ::readdir(dir);
+
+        if (dirent == nullptr) {
+            errorCode = errno;
+            return false;
+        }
+
+        const char *name = dirent->d_name;
+        if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+            continue;
+
+        entry.name = name;
+        entry.nameLength = static_cast<int>(strlen(name));
+#ifdef DT_UNKNOWN
+        entry.type = dirent->d_type;
+#else
+        entry.type = DT_UNKNOWN;
+#endif
+        entry.inode = dirent->d_ino;
+        return true;
+    }
+#endif
+}
+
+/*!
+ * \brief Gets the metadata of \a entry relative to the directory being enumerated.
+ * \param entry an entry returned by next().
+ * \param metadata a Metadata object to fill.
+ * \param followSymlinks true if symbolic links should be resolved.
+ * \return true if successful.
+ */
+bool UnixDirectoryEnumerator::stat(const Entry &entry, Metadata &metadata, bool followSymlinks) const
+{
+    return stat(dirFd, entry.name, metadata, followSymlinks);
+}
+
+/*!
+ * \brief Returns true if \a entry is a directory, or a symbolic link to a directory.
+ * \param entry an entry returned by next().
+ *
+ * The d_type of the entry is used whenever possible.  Only entries with an unknown type or symbolic
+ * links need a call to stat().
+ */
+bool UnixDirectoryEnumerator::isDirectory(const Entry &entry) const
+{
+    switch (entry.type) {
+        case DT_DIR:
+            return true;
+        case DT_UNKNOWN:
+        case DT_LNK: {
+            Metadata metadata;
+            return stat(entry, metadata) && metadata.isDirectory();
+        }
+        default:
+            return false;
+    }
+}
+
+/*!
+ * \brief Gets the metadata of the file \a name relative to the directory file descriptor \a dirFd.
+ * \param dirFd a file descriptor of an open directory, or AT_FDCWD.
+ * \param name a file name in the native encoding.
+ * \param metadata a Metadata object to fill.
+ * \param followSymlinks true if symbolic links should be resolved.
+ * \return true if successful.
+ *
+ * On Linux statx() is used when available, asking only for the fields we need and without forcing
+ * network filesystems to synchronize with the server.
+ */
+bool UnixDirectoryEnumerator::stat(int dirFd, const char *name, Metadata &metadata, bool followSymlinks)
+{
+    int flags = followSymlinks ? 0 : AT_SYMLINK_NOFOLLOW;
+
+#if defined(Q_OS_LINUX) && defined(STATX_BASIC_STATS)
+    // Several retriever threads stat at the same time
+    static std::atomic<bool> hasStatx { true };
+
+    if (hasStatx.load(std::memory_order_relaxed)) {
+        struct statx buffer;
+        unsigned int mask = STATX_TYPE | STATX_MODE | STATX_NLINK | STATX_SIZE | STATX_MTIME | STATX_ATIME | STATX_BTIME;
+
+        if (::statx(dirFd, name, flags | AT_STATX_DONT_SYNC, mask, &buffer) == 0) {
+            metadata.size = buffer.stx_size;
+            metadata.links = buffer.stx_nlink;
+            metadata.mode = buffer.stx_mode;
+            metadata.modifiedTime = buffer.stx_mtime.tv_sec * NSECS_PER_SEC + buffer.stx_mtime.tv_nsec;
+            metadata.accessTime = buffer.stx_atime.tv_sec * NSECS_PER_SEC + buffer.stx_atime.tv_nsec;
+            metadata.creationTime = (buffer.stx_mask & STATX_BTIME) ?
+                                        buffer.stx_btime.tv_sec * NSECS_PER_SEC + buffer.stx_btime.tv_nsec : 0;
+            return true;
+        }
+
+        // Old kernels don't have statx(), fall back to fstatat()
+        if (errno != ENOSYS)
+            return false;
+
+        hasStatx.store(false, std::memory_order_relaxed);
+    }
+#endif
+
+    struct stat buffer;
+    if (::fstatat(dirFd, name, &buffer, flags) != 0)
+        return false;
+
+    metadata.size = static_cast<quint64>(buffer.st_size);
+    metadata.links = static_cast<quint64>(buffer.st_nlink);
+    metadata.mode = buffer.st_mode;
+
+#ifdef Q_OS_DARWIN
+    metadata.modifiedTime = buffer.st_mtimespec.tv_sec * NSECS_PER_SEC + buffer.st_mtimespec.tv_nsec;
+    metadata.accessTime = buffer.st_atimespec.tv_sec * NSECS_PER_SEC + buffer.st_atimespec.tv_nsec;
+    metadata.creationTime = buffer.st_birthtimespec.tv_sec * NSECS_PER_SEC + buffer.st_birthtimespec.tv_nsec;
+#else
+    metadata.modifiedTime = buffer.st_mtim.tv_sec * NSECS_PER_SEC + buffer.st_mtim.tv_nsec;
+    metadata.accessTime = buffer.st_atim.tv_sec * NSECS_PER_SEC + buffer.st_atim.tv_nsec;
+    metadata.creationTime = 0;
+#endif
+
+    return true;
+}
+
+/*!
+ * \brief Returns true if the link count of the folders in the filesystem of \a dirFd counts their subfolders.
+ * \param dirFd a file descriptor of an open directory.
+ *
+ * In traditional Unix filesystems every subfolder has a ".." link to its parent, so a folder with a link count of 2
+ * has no subfolders.  Many filesystems (btrfs, most network and FUSE filesystems) always report 1 or an arbitrary
+ * value, so only the filesystems known to keep this count are trusted.
+ */
+bool UnixDirectoryEnumerator::linkCountIncludesSubFolders(int dirFd)
+{
+#ifdef Q_OS_LINUX
+    struct statfs buffer;
+    if (::fstatfs(dirFd, &buffer) != 0)
+        return false;
+
+    switch (static_cast<unsigned long>(buffer.f_type)) {
+        case EXT4_SUPER_MAGIC:
+        case XFS_SUPER_MAGIC:
+        case TMPFS_MAGIC:
+        case JFS_SUPER_MAGIC:
+        case REISERFS_SUPER_MAGIC:
+        case F2FS_SUPER_MAGIC:
+            return true;
+        default:
+            return false;
+    }
+#else
+    Q_UNUSED(dirFd)
+    return false;
+#endif
+}
+
+bool UnixDirectoryEnumerator::Metadata::isDirectory() const
+{
+    return S_ISDIR(mode);
+}
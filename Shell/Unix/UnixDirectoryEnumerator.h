@@ -0,0 +1,77 @@
+#ifndef UNIXDIRECTORYENUMERATOR_H
+#define UNIXDIRECTORYENUMERATOR_H
+
+#include <QtGlobal>
+
+#include <sys/types.h>
+#include <dirent.h>
+
+/*!
+ * \brief Bulk directory enumerator for POSIX systems.
+ *
+ * This class reads the entries of a directory through a single open directory file descriptor.
+ *
+ * On Linux the entries are read with getdents64() in large batches, so a directory of several hundred
+ * thousand entries only needs a few hundred system calls to be read.  On other POSIX systems it falls
+ * back to readdir().
+ *
+ * The type of every entry is taken from d_type whenever the filesystem provides it, so callers can
+ * avoid a stat() call when they only need to know if an entry is a directory.  When metadata is needed
+ * it is resolved with statx() or fstatat() relative to the directory file descriptor, which avoids
+ * resolving the full path again for every entry.
+ */
+class UnixDirectoryEnumerator
+{
+public:
+
+    struct Entry {
+        const char     *name        {};    // Points to the internal buffer, valid until the next call to next()
+        int             nameLength  {};
+        unsigned char   type        { DT_UNKNOWN };
+        quint64         inode       {};
+    };
+
+    struct Metadata {
+        quint64     size            {};
+        quint64     links           {};
+        quint32     mode            {};
+        qint64      modifiedTime    {};    // Nanoseconds since epoch
+        qint64      accessTime      {};    // Nanoseconds since epoch
+        qint64      creationTime    {};    // Nanoseconds since epoch, 0 if the filesystem does not provide it
+
+        bool isDirectory() const;
+    };
+
+    explicit UnixDirectoryEnumerator(const char *path);
+    UnixDirectoryEnumerator(int parentFd, const char *name);
+    ~UnixDirectoryEnumerator();
+
+    bool isOpen() const;
+    int error() const;
+    int fd() const;
+
+    bool next(Entry &entry);
+    bool stat(const Entry &entry, Metadata &metadata, bool followSymlinks = true) const;
+    bool isDirectory(const Entry &entry) const;
+
+    static bool stat(int dirFd, const char *name, Metadata &metadata, bool followSymlinks = true);
+    static bool linkCountIncludesSubFolders(int dirFd);
+
+private:
+    int         dirFd               { -1 };
+    int         errorCode           {};
+
+#ifdef Q_OS_LINUX
+    char       *buffer              {};
+    long        bufferPos           {};
+    long        bufferEnd           {};
+#else
+    DIR        *dir                 {};
+#endif
+
+    void open(int parentFd, const char *name);
+
+    Q_DISABLE_COPY(UnixDirectoryEnumerator)
+};
+
+#endif // UNIXDIRECTORYENUMERATOR_H
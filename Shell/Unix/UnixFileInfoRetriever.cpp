@@ -1,27 +1,19 @@
 #include <QFileIconProvider>
-#include <QMimeDatabase>
-#include <QDateTime>
+#include <QApplication>
 #include <QPainter>
 #include <QDebug>
 #include <QString>
+#include <QFile>
 #include <QTime>
 
 #include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
 
 #include "Shell/Unix/UnixFileInfoRetriever.h"
 #include "Shell/FileSystemItem.h"
-
-#ifdef Q_OS_WIN
-// This is for debugging the Unix implementation from Windows
-#define QString_fromStdString(path)             QString::fromStdWString(path.wstring())
-#define QString_toStdString(str)                str.toStdWString()
-#define QString_toCString(str)                  str.toStdString().c_str()
-#else
-// POSIX systems are already Unicode aware, and attempts to convert to wstring will end up in error anyway
-#define QString_fromStdString(path)             QString::fromStdString(path.string())
-#define QString_toStdString(str)                str.toStdString()
-#define QString_toCString(str)                  str.toStdString().c_str()
-#endif
+#include "Shell/FileTypeCache.h"
 
 UnixFileInfoRetriever::UnixFileInfoRetriever(QObject *parent) : FileInfoRetriever(parent)
 {
@@ -29,183 +21,336 @@ UnixFileInfoRetriever::UnixFileInfoRetriever(QObject *parent) : FileInfoRetrieve
 
 bool UnixFileInfoRetriever::getParentBackground(FileSystemItem *parent)
 {
-    QFileIconProvider iconProvider;
+    qDebug() << "UnixFileInfoRetriever::getParentBackground Parent path" << parent->getPath();
 
-    qDebug() << "UnixFileInfoRetriever::getParentInfo" << getScope() << "Parent path" << parent->getPath();
+    parent->setErrorCode(0);
 
     // If this is the root we need to retrieve the display name of it and its icon
     if (parent->getPath() == "/") {
-        parent->setDisplayName("File System");
+        parent->setDisplayName(tr("File System"));
         parent->setHasSubFolders(true);
     } else {
-        std::error_code ec;
-        fs::path path = QString_toStdString(parent->getPath());
-        if (fs::exists(path), &ec) {
-            parent->setDisplayName(QString_fromStdString(path.filename()));
-            parent->setHasSubFolders(hasSubFolders(path));
-        } else {
-            QString errMessage = QString::fromStdString(ec.message());
-            qint32 err = ec.value();
-
-            qDebug() << "UnixFileInfoRetriever::getParentInfo" << getScope() << "Couldn't access" << parent->getPath() << "error_code" << err << "(" << errMessage << ")";
-            emit parentUpdated(parent, err, errMessage);
+        QByteArray path = parent->getNativePath();
+        UnixDirectoryEnumerator::Metadata metadata;
+
+        if (!UnixDirectoryEnumerator::stat(AT_FDCWD, path.constData(), metadata)) {
+            int err = errno;
+            QString errMessage = qt_error_string(err);
+
+            qDebug() << "UnixFileInfoRetriever::getParentBackground Couldn't access" << parent->getPath() << "errno" << err << "(" << errMessage << ")";
+
+            parent->setErrorCode(err);
+            parent->setErrorMessage(errMessage);
+
+            emit parentInfoUpdated(parent);
             return false;
         }
+
+        parent->setFolder(metadata.isDirectory());
+        parent->setDisplayName(QFile::decodeName(parent->getNativeName()));
+        parent->setHasSubFolders(metadata.isDirectory() && hasSubFolders(AT_FDCWD, path.constData()));
+        setMetadata(parent, metadata);
     }
+
     parent->setIcon(getIcon(parent));
-    qDebug() << "UnixFileInfoRetriever::getParentInfo" << getScope() << "Root name is " << parent->getDisplayName();
+    qDebug() << "UnixFileInfoRetriever::getParentBackground Root name is" << parent->getDisplayName();
+
+    emit parentInfoUpdated(parent);
 
     return true;
 }
 
+/*!
+ * \brief Gets all the children of \a parent using a UnixDirectoryEnumerator.
+ * \param parent a FileSystemItem folder.
+ *
+ * The folder is opened only once and all its entries are read in large batches.  The type of every entry is
+ * taken from the directory entry itself, so a stat() is only needed for symbolic links or filesystems that
+ * don't provide it.
+ *
+ * The children keep the names as they come from the filesystem, and they're not decoded here.  The extensions and
+ * types of the files come from the last suffixes of their names, which only takes a lookup in the FileTypeCache.
+ *
+ * In streaming mode the listing is done in two phases: the children are published with their names, extensions and
+ * types, and their size and dates are retrieved afterwards by a Metadata job.  Otherwise the metadata is retrieved
+ * here before parentChildrenUpdated is emitted.
+ *
+ * \sa getMetadataBackground
+ */
 void UnixFileInfoRetriever::getChildrenBackground(FileSystemItem *parent)
 {
-    qDebug() << "UnixFileInfoRetriever::getChildrenBackground " << getScope();
+    qDebug() << "UnixFileInfoRetriever::getChildrenBackground Parent path" << parent->getPath();
+
+    QTime start;
+    start.start();
+
+    parent->setErrorCode(0);
 
-    // Sometimes the last folder is deleted between getParentInfo and this function
-    // We need to double check it
     bool subFolders {};
 
-    QString root = parent->getPath();
+    QList<FileSystemItem *> children;
 
-#ifdef Q_OS_WIN
-    // This is for debugging the Unix implementation from Windows
-    if (root == "/")
-        root = "C:\\";
-#endif
+    UnixDirectoryEnumerator enumerator(parent->getNativePath().constData());
 
-    for(auto& path: fs::directory_iterator(QString_toStdString(root), fs::directory_options::skip_permission_denied)) {
+    if (enumerator.isOpen()) {
 
-        if (!running.load())
-            break;
+        QString folderType = QApplication::translate("QFileDialog", "Folder");
 
-        if (getScope() == FileInfoRetriever::List || fs::is_directory(path)) {
+        UnixDirectoryEnumerator::Entry entry;
 
-            QString strPath = QString_fromStdString(path.path());
+        while (isRunning() && enumerator.next(entry)) {
 
-#ifdef Q_OS_WIN
-            // This is for debugging the Unix implementation from Windows
-            strPath = strPath.replace('\\', '/');
-#endif
-            // Get the absolute path and create a FileSystemItem with it
-            FileSystemItem *child = new FileSystemItem(strPath);
+            FileSystemItem *child = newNamedChild(parent, QByteArray(entry.name, entry.nameLength));
 
-            // Get the display name
-            child->setDisplayName(QString_fromStdString(path.path().filename()));
-            qDebug() << "UnixFileInfoRetriever::getChildrenBackground" << getScope() << child->getPath();
+            bool isDirectory = enumerator.isDirectory(entry);
 
-            // Set basic attributes
-            bool isDirectory = fs::is_directory(path);
             child->setFolder(isDirectory);
+            child->setHidden(entry.name[0] == '.');
+            child->setMetadataState(FileSystemItem::MetadataPending);
+
+            // Finding out if a folder has subfolders means reading it, so assume it has until proven otherwise
+            // \sa getMetadataBackground \sa getSubFoldersBackground
             if (isDirectory) {
-                qDebug() << "UnixFileInfoRetriever::getChildrenBackground" << child->getPath() << "is a directory";
-                if (!subFolders && isDirectory)
-                    subFolders = true;
+                subFolders = true;
+                child->setType(folderType);
+                child->setHasSubFolders(true);
+                child->setSubFoldersState(FileSystemItem::SubFoldersPending);
+            } else {
+                // The strings of a child can't change once it's published, so its extension and type are set here.
+                // The name itself is decoded when it's displayed
+                FileTypeCache::FileType fileType = FileTypeCache::lookup(child->getNativeName());
+                child->setExtension(fileType.extension);
+                child->setType(fileType.description);
             }
-            child->setHasSubFolders(isDirectory ? hasSubFolders(path) : false);
-            child->setHidden(child->getDisplayName().at(0) == '.');
 
-            struct stat buffer {};
-            stat(QString_toCString(strPath), &buffer);
-            child->setSize(static_cast<quint64>(buffer.st_size));
-            child->setLastChangeTime(QDateTime::fromTime_t(static_cast<uint>(buffer.st_mtime)));
-            child->setLastAccessTime(QDateTime::fromTime_t(static_cast<uint>(buffer.st_atime)));
+            child->setCapabilities(FSI_CAN_COPY | FSI_CAN_MOVE | FSI_CAN_LINK | FSI_CAN_RENAME | FSI_CAN_DELETE |
+                                   (isDirectory ? FSI_DROP_TARGET : 0));
 
-            parent->addChild(child);
+            children.append(child);
+            addChild(parent, child);
         }
+
+        if (enumerator.error()) {
+            parent->setErrorCode(enumerator.error());
+            parent->setErrorMessage(qt_error_string(enumerator.error()));
+        }
+
+    } else {
+        parent->setErrorCode(enumerator.error());
+        parent->setErrorMessage(qt_error_string(enumerator.error()));
+
+        qDebug() << "UnixFileInfoRetriever::getChildrenBackground got error while trying to enumerate children:"
+                 << parent->getErrorCode() << parent->getErrorMessage();
     }
 
-    parent->setHasSubFolders(subFolders);
-    parent->setAllChildrenFetched(true);
-    emit parentUpdated(parent, 0, QString());
+    // Without streaming nobody can see the children yet, so get their metadata and set it now
+    if (!isStreaming() && isRunning()) {
+        QVector<Metadata> metadata;
+        getMetadataBackground(parent, children, metadata);
+        applyMetadata(children, metadata);
+    }
+
+    if (!isRunning()) {
+        qDebug() << "UnixFileInfoRetriever::getChildrenBackground Parent path" << parent->getPath() << "aborted!";
+        parent->setErrorCode(-1);
+    } else {
+        parent->setHasSubFolders(subFolders);
+        parent->setSubFoldersState(FileSystemItem::SubFoldersKnown);
+        qDebug() << "UnixFileInfoRetriever::getChildrenBackground Parent path" << parent->getPath() << "finished in" << start.elapsed() << "milliseconds";
+    }
+
+    if (!parent->getErrorCode())
+        parent->setAllChildrenFetched(true);
 
-    if (getScope() == FileInfoRetriever::List)
-         getExtendedInfo(parent);
+    // Publish the last children and emit the parentChildrenUpdated signal
+    flushChildren(parent);
+    emit parentChildrenUpdated(parent);
 
-    running.store(false);
+    // Second phase
+    if (isStreaming() && !parent->getErrorCode() && !children.isEmpty())
+        getMetadata(parent, children);
 }
 
-QString toTitleCase(QString str)
+/*!
+ * \brief Returns true in streaming mode, where the children are stat()ed by a second pass.
+ */
+bool UnixFileInfoRetriever::isMetadataDeferred() const
 {
-    QString result;
-    QStringList strList = str.split(' ');
-    for (auto word : strList) {
-        if (!result.isEmpty())
-            result += ' ';
-        result += word.replace(0, 1, word.at(0).toUpper());
-    }
-    return result;
+    return isStreaming();
 }
 
-void UnixFileInfoRetriever::getExtendedInfo(FileSystemItem *parent)
+/*!
+ * \brief Gets the size and dates of the \a children of \a parent.
+ * \param parent a FileSystemItem folder.
+ * \param children the children of \a parent whose metadata is pending.
+ * \param metadata the size and dates of every child, in the same order.
+ *
+ * The folder is opened once and every child is stat()ed relative to it.  The children may be shown in a view already,
+ * so only their flags are changed here.  Their size and dates are set by applyMetadata() in the thread of the model.
+ *
+ * If the link count of the folders in this filesystem counts their subfolders, it's also used to find out if the
+ * children folders have subfolders without reading them.
+ */
+void UnixFileInfoRetriever::getMetadataBackground(FileSystemItem *parent, QList<FileSystemItem *> children, QVector<Metadata> &metadata)
 {
-    qDebug() << "UnixFileInfoRetriever::getExtendedInfo " << getScope() << " Parent path " << parent->getPath();
+    int dirFd = ::open(parent->getNativePath().constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
 
-    QTime start;
-    start.start();
+    UnixDirectoryEnumerator::Metadata childMetadata;
 
-    QMimeDatabase mimeDatabase;
+    bool linkCountIncludesSubFolders = dirFd >= 0 && UnixDirectoryEnumerator::linkCountIncludesSubFolders(dirFd);
 
-    if (parent != nullptr && parent->areAllChildrenFetched()) {
+    metadata.resize(children.size());
 
-        for (auto item : parent->getChildren()) {
+    for (int i = 0; i < children.size(); i++) {
 
-            if (!running.load())
-                break;
+        if (!isRunning())
+            break;
 
-            if (!item->isFolder()) {
+        FileSystemItem *child = children.at(i);
+        if (child->isMetadataComplete())
+            continue;
 
-                QList<QMimeType> mimeList = mimeDatabase.mimeTypesForFileName(item->getDisplayName());
-                if (mimeList.size() > 0)
-                    item->setType(toTitleCase(mimeList.at(0).comment()));
-                else {
-                    QString strType;
-                    if (!item->getExtension().isEmpty())
-                        strType = item->getExtension().toUpper() + ' ';
+        if (dirFd >= 0 && UnixDirectoryEnumerator::stat(dirFd, child->getNativeName().constData(), childMetadata)) {
+            metadata[i] = toMetadata(childMetadata);
 
-                    item->setType(strType + tr("File"));
-                }
+            if (child->isFolder() && linkCountIncludesSubFolders && childMetadata.isDirectory()) {
+                child->setHasSubFolders(childMetadata.links > 2);
+                child->setSubFoldersState(FileSystemItem::SubFoldersKnown);
             }
-
-            emit itemUpdated(item);
         }
 
-        if (!running.load()) {
-            qDebug() << "UnixFileInfoRetriever::getExtendedInfo " << getScope() << "Parent path " << parent->getPath() << " aborted!";
-            return;
-        }
+        metadata[i].fetched = true;
+    }
+
+    if (dirFd >= 0)
+        ::close(dirFd);
+}
 
-        // We need to signal the model that all the children need to be re-sorted
-        emit (extendedInfoUpdated(parent));
+/*!
+ * \brief Finds out if the folder \a item has subfolders.
+ * \param item a FileSystemItem folder.
+ */
+void UnixFileInfoRetriever::getSubFoldersBackground(FileSystemItem *item)
+{
+    item->setHasSubFolders(hasSubFolders(AT_FDCWD, item->getNativePath().constData()));
+    item->setSubFoldersState(FileSystemItem::SubFoldersKnown);
+}
+
+void UnixFileInfoRetriever::setMetadata(FileSystemItem *item, const UnixDirectoryEnumerator::Metadata &metadata)
+{
+    applyMetadata(QList<FileSystemItem *> { item }, QVector<Metadata> { toMetadata(metadata) });
+}
+
+FileInfoRetriever::Metadata UnixFileInfoRetriever::toMetadata(const UnixDirectoryEnumerator::Metadata &metadata)
+{
+    Metadata result;
+    result.fetched = true;
+
+    if (!metadata.isDirectory())
+        result.size = metadata.size;
+
+    result.lastChangeTime = metadata.modifiedTime;
+    result.lastAccessTime = metadata.accessTime;
+
+    if (metadata.creationTime)
+        result.creationTime = metadata.creationTime;
+
+    return result;
+}
+
+/*!
+ * \brief Returns true if the folder \a name has at least one subfolder.
+ * \param parentFd the file descriptor of the parent of the folder, or AT_FDCWD.
+ * \param name the name of the folder relative to parentFd, in the native encoding.
+ *
+ * The link count of the folder is used when it's meaningful, otherwise the folder is read until the first subfolder
+ * is found.
+ */
+bool UnixFileInfoRetriever::hasSubFolders(int parentFd, const char *name)
+{
+    UnixDirectoryEnumerator enumerator(parentFd, name);
+
+    if (!enumerator.isOpen())
+        return false;
+
+    UnixDirectoryEnumerator::Metadata metadata;
+    if (UnixDirectoryEnumerator::linkCountIncludesSubFolders(enumerator.fd()) &&
+            UnixDirectoryEnumerator::stat(enumerator.fd(), ".", metadata))
+        return metadata.links > 2;
+
+    UnixDirectoryEnumerator::Entry entry;
+    while (enumerator.next(entry)) {
+        if (enumerator.isDirectory(entry))
+            return true;
     }
 
-    qDebug() << "UnixFileInfoRetriever::getExtendedInfo Finished in" << start.elapsed() << "milliseconds";
+    return false;
 }
 
-bool UnixFileInfoRetriever::hasSubFolders(fs::path path)
+bool UnixFileInfoRetriever::refreshItem(FileSystemItem *fileSystemItem)
 {
-    if (!fs::is_directory(path))
+    if (fileSystemItem == nullptr)
         return false;
 
-    try {
-        for (auto& child: fs::directory_iterator(path)) {
-            if (fs::is_directory(child))
-                return true;
-        }
-    } catch (const std::exception& e) {
-        qDebug() << "Exception while trying to read folder: " << e.what();
+    qDebug() << "UnixFileInfoRetriever::refreshItem item" << fileSystemItem->getPath();
+
+    QByteArray path = fileSystemItem->getNativePath();
+    UnixDirectoryEnumerator::Metadata metadata;
+
+    if (!UnixDirectoryEnumerator::stat(AT_FDCWD, path.constData(), metadata)) {
+        qDebug() << "UnixFileInfoRetriever::refreshItem item" << fileSystemItem->getPath() << "seems that it doesn't exist anymore";
+        return false;
+    }
+
+    QString name = QFile::decodeName(fileSystemItem->getNativeName());
+
+    fileSystemItem->setFolder(metadata.isDirectory());
+    fileSystemItem->setDisplayName(name);
+    fileSystemItem->setHidden(name.startsWith('.'));
+    fileSystemItem->setCapabilities(FSI_CAN_COPY | FSI_CAN_MOVE | FSI_CAN_LINK | FSI_CAN_RENAME | FSI_CAN_DELETE |
+                                    (metadata.isDirectory() ? FSI_DROP_TARGET : 0));
+    setMetadata(fileSystemItem, metadata);
+
+    if (fileSystemItem->isFolder())
+        fileSystemItem->setType(QApplication::translate("QFileDialog", "Folder"));
+    else
+        fileSystemItem->setType(FileTypeCache::lookup(name).description);
+
+    fileSystemItem->setMetadataState(FileSystemItem::MetadataComplete);
+
+    if (metadata.isDirectory()) {
+        fileSystemItem->setHasSubFolders(hasSubFolders(AT_FDCWD, path.constData()));
+        fileSystemItem->setSubFoldersState(FileSystemItem::SubFoldersKnown);
     }
 
+    emit itemUpdated(fileSystemItem);
+
+    return true;
+}
+
+bool UnixFileInfoRetriever::willRecycle(FileSystemItem *fileSystemItem)
+{
+    Q_UNUSED(fileSystemItem)
+
+    // TODO: It's called Trash in Unix and it's in $XDG_DATA_HOME/Trash or .local/share/Trash
     return false;
 }
 
+void UnixFileInfoRetriever::getIconBackground(FileSystemItem *item, bool background)
+{
+    QIcon icon = getIcon(item);
+    if (!icon.isNull())
+        item->setIcon(icon);
+
+    if (background)
+        emit iconUpdated(item);
+}
+
 QIcon UnixFileInfoRetriever::getIcon(FileSystemItem *item) const
 {
     QFileIconProvider iconProvider;
     QString strPath = item->getPath();
 
-    qDebug() << "UnixFileInfoRetriever::getIcon " << getScope() << strPath;
-
     // Set icon using QFileInfo
     QIcon icon;
     if (strPath == "/")
@@ -215,10 +360,6 @@ QIcon UnixFileInfoRetriever::getIcon(FileSystemItem *item) const
         icon = iconProvider.icon(fileInfo);
     }
 
-#ifdef Q_OS_WIN
-    // This is for debugging the Unix implementation from Windows
-    return icon;
-#else
     // This probably would be part of the configuration
     // TODO: Check QApplication::style()->pixelMetric(QStyle::PM_SmallIconSize);
     QPixmap pixmap = icon.pixmap(16);
@@ -239,6 +380,4 @@ QIcon UnixFileInfoRetriever::getIcon(FileSystemItem *item) const
     }
 
     return QIcon(pixmap);
-#endif
 }
-
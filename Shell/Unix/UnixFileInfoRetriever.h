@@ -1,25 +1,30 @@
 #ifndef UNIXFILEINFORETRIEVER_H
 #define UNIXFILEINFORETRIEVER_H
 
-#include <experimental/filesystem>
-
 #include "Shell/FileInfoRetriever.h"
-
-namespace fs = std::experimental::filesystem;
+#include "Shell/Unix/UnixDirectoryEnumerator.h"
 
 class UnixFileInfoRetriever : public FileInfoRetriever
 {
 public:
     UnixFileInfoRetriever(QObject *parent = nullptr);
-    QIcon getIcon(FileSystemItem *item) const override;
+
+    bool refreshItem(FileSystemItem *fileSystemItem) override;
+    bool willRecycle(FileSystemItem *fileSystemItem) override;
+    bool isMetadataDeferred() const override;
 
 protected:
     void getChildrenBackground(FileSystemItem *parent) override;
     bool getParentBackground(FileSystemItem *parent) override;
-    void getExtendedInfo(FileSystemItem *parent) override;
+    void getIconBackground(FileSystemItem *item, bool background = true) override;
+    void getMetadataBackground(FileSystemItem *parent, QList<FileSystemItem *> children, QVector<Metadata> &metadata) override;
+    void getSubFoldersBackground(FileSystemItem *item) override;
 
 private:
-    bool hasSubFolders(fs::path path);
+    void setMetadata(FileSystemItem *item, const UnixDirectoryEnumerator::Metadata &metadata);
+    static Metadata toMetadata(const UnixDirectoryEnumerator::Metadata &metadata);
+    bool hasSubFolders(int parentFd, const char *name);
+    QIcon getIcon(FileSystemItem *item) const;
 };
 
 #endif // UNIXFILEINFORETRIEVER_H
@@ -1,4 +1,3 @@
-#include <QSortFilterProxyModel>
 #include <QApplication>
 #include <QClipboard>
 #include <QMimeData>
@@ -8,6 +7,7 @@
 #include <ole2.h>
 
 #include "View/Base/BaseTreeView.h"
+#include "Model/SortModel.h"
 #include "WinContextMenu.h"
 
 #define SCRATCH_QCM_FIRST      1
@@ -58,8 +58,8 @@ void WinContextMenu::show(const WId wId, const QPoint &pos, const QModelIndexLis
         IShellFolder *psf;
         LPCITEMIDLIST pidlChild {};
         PCUITEMID_CHILD_ARRAY pidlList {};
-        QSortFilterProxyModel *proxyModel = reinterpret_cast<QSortFilterProxyModel *>(view->model());
-        FileSystemModel *model = reinterpret_cast<FileSystemModel *>(proxyModel->sourceModel());
+        SortModel *proxyModel = reinterpret_cast<SortModel *>(view->model());
+        FileSystemModel *model = proxyModel->getFileSystemModel();
 
         // All items have the same parent we just need one to bind to the parent
         if (SUCCEEDED(hr = ::SHBindToParent(pidl, IID_IShellFolder, reinterpret_cast<void**>(&psf), &pidlChild))) {
@@ -155,7 +155,7 @@ void WinContextMenu::show(const WId wId, const QPoint &pos, const QModelIndexLis
 
                         if (strVerb == VERB_RENAME && view != nullptr && indexList.size() == 1) {
 
-                            QModelIndex proxyIndex = proxyModel->mapFromSource(indexList[0]);
+                            QModelIndex proxyIndex = proxyModel->mapFromFileSystemModel(indexList[0]);
 
                             view->edit(proxyIndex);
 
@@ -186,7 +186,7 @@ void WinFileInfoRetriever::getChildrenBackground(FileSystemItem *parent)
 
                 LPITEMIDLIST pidlChild {};
 
-                while (running.load() && ppenumIDList->Next(1, &pidlChild, nullptr) == S_OK) {
+                while (isRunning() && ppenumIDList->Next(1, &pidlChild, nullptr) == S_OK) {
 
                     // qDebug() << "WinFileInfoRetriever::getChildrenBackground" << QTime::currentTime() << "Before getting attributes";
                     SFGAOF attributes { SFGAO_STREAM };
@@ -203,7 +203,7 @@ void WinFileInfoRetriever::getChildrenBackground(FileSystemItem *parent)
                     if (displayName == CONTROL_PANEL_GUID || displayName == CONTROL_PANEL_GUID_2)
                         continue;
 
-                    FileSystemItem *child = new FileSystemItem(displayName);
+                    FileSystemItem *child = newChild(parent, displayName);
 
                     getChildInfo(psf, pidlChild, child);
 
@@ -212,7 +212,7 @@ void WinFileInfoRetriever::getChildrenBackground(FileSystemItem *parent)
                         if (child->isFolder() && !subFolders)
                             subFolders = true;
 
-                        parent->addChild(child);
+                        addChild(parent, child);
                     }
 
                     ::ILFree(pidlChild);
@@ -235,7 +235,7 @@ void WinFileInfoRetriever::getChildrenBackground(FileSystemItem *parent)
 
         // TODO: Everything from here should be in parent class, and this function should call the parent version here
 
-        if (!running.load()) {
+        if (!isRunning()) {
             qDebug() << "WinFileInfoRetriever::getChildrenBackground Parent path " << parent->getPath() << "aborted!";
             parent->setErrorCode(-1);
         } else {
@@ -248,7 +248,8 @@ void WinFileInfoRetriever::getChildrenBackground(FileSystemItem *parent)
         if (!parent->getErrorCode())
             parent->setAllChildrenFetched(true);
 
-        // Emit the parentChildrenUpdated signal
+        // Publish the last children and emit the parentChildrenUpdated signal
+        flushChildren(parent);
         emit parentChildrenUpdated(parent);
     }
 
@@ -0,0 +1,6 @@
+# Checks that the children of a folder are found by their paths after they're added, removed and renamed.
+
+include(../Tests.pri)
+
+SOURCES += \
+    tst_childrenindex.cpp
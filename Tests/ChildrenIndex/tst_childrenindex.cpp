@@ -0,0 +1,138 @@
+#include <QtTest>
+#include <QDir>
+
+#include "Shell/FileSystemItem.h"
+
+// Enough children to grow the table of the index several times
+#define CHILDREN        1000
+
+class TestChildrenIndex : public QObject
+{
+    Q_OBJECT
+
+private:
+    FileSystemItem *folder      {};
+    QList<FileSystemItem *> children;
+
+    static FileSystemItem::NativeString nativeName(int n);
+    QString childPath(int n) const;
+    void addChildren(int first, int count);
+
+private slots:
+    void init();
+    void cleanup();
+
+    void findsEveryChild();
+    void findsChildWithAbsolutePath();
+    void findsChildrenAfterRemovals();
+    void findsRenamedChild();
+};
+
+FileSystemItem::NativeString TestChildrenIndex::nativeName(int n)
+{
+#ifdef Q_OS_WIN
+    return QString("file%1.txt").arg(n);
+#else
+    return QByteArray("file") + QByteArray::number(n) + QByteArray(".txt");
+#endif
+}
+
+QString TestChildrenIndex::childPath(int n) const
+{
+    return folder->getPath() + QDir::separator() + QString("file%1.txt").arg(n);
+}
+
+void TestChildrenIndex::addChildren(int first, int count)
+{
+    for (int i = first; i < first + count; i++) {
+        FileSystemItem *child = new FileSystemItem(folder, nativeName(i));
+        folder->addChild(child);
+        children.append(child);
+    }
+}
+
+void TestChildrenIndex::init()
+{
+    folder = new FileSystemItem(QDir::toNativeSeparators(QDir::rootPath() + "folder"));
+    children.clear();
+}
+
+void TestChildrenIndex::cleanup()
+{
+    delete folder;
+    folder = nullptr;
+}
+
+void TestChildrenIndex::findsEveryChild()
+{
+    addChildren(0, CHILDREN);
+
+    for (int i = 0; i < CHILDREN; i++) {
+        QCOMPARE(folder->getChild(childPath(i)), children.at(i));
+        QCOMPARE(folder->childRow(children.at(i)), i);
+    }
+
+    // Names that only share a prefix with the ones of the children, or paths of another folder
+    QVERIFY(folder->getChild(childPath(CHILDREN)) == nullptr);
+    QVERIFY(folder->getChild(folder->getPath() + QDir::separator() + "file1") == nullptr);
+    QVERIFY(folder->getChild(QDir::toNativeSeparators(QDir::rootPath() + "other/file1.txt")) == nullptr);
+}
+
+void TestChildrenIndex::findsChildWithAbsolutePath()
+{
+    addChildren(0, 10);
+
+    // Like a drive or a virtual item, whose path is not below the folder
+    QString path = QDir::toNativeSeparators(QDir::rootPath() + "elsewhere/file1.txt");
+    FileSystemItem *child = new FileSystemItem(path, folder);
+    folder->addChild(child);
+
+    QCOMPARE(folder->getChild(path), child);
+    QCOMPARE(folder->getChild(childPath(1)), children.at(1));
+}
+
+void TestChildrenIndex::findsChildrenAfterRemovals()
+{
+    addChildren(0, CHILDREN);
+
+    for (int i = 0; i < CHILDREN; i += 2) {
+        folder->removeChild(childPath(i));
+        delete children.at(i);
+    }
+
+    for (int i = 0; i < CHILDREN; i++) {
+        if (i % 2 == 0) {
+            QVERIFY(folder->getChild(childPath(i)) == nullptr);
+        } else {
+            QCOMPARE(folder->getChild(childPath(i)), children.at(i));
+            QCOMPARE(folder->childRow(children.at(i)), i / 2);
+        }
+    }
+
+    // The new children reuse the slots of the removed ones, and grow the table again
+    addChildren(CHILDREN, CHILDREN);
+
+    for (int i = 1; i < 2 * CHILDREN; i++) {
+        if (i < CHILDREN && i % 2 == 0)
+            continue;
+
+        QCOMPARE(folder->getChild(childPath(i)), children.at(i));
+    }
+
+    QCOMPARE(folder->childrenCount(), CHILDREN / 2 + CHILDREN);
+}
+
+void TestChildrenIndex::findsRenamedChild()
+{
+    addChildren(0, 10);
+
+    folder->updateChildPath(children.at(3), childPath(100));
+
+    QVERIFY(folder->getChild(childPath(3)) == nullptr);
+    QCOMPARE(folder->getChild(childPath(100)), children.at(3));
+    QCOMPARE(folder->childRow(children.at(3)), 3);
+}
+
+QTEST_GUILESS_MAIN(TestChildrenIndex)
+
+#include "tst_childrenindex.moc"
@@ -0,0 +1,10 @@
+# Checks that the filter of the detailed view finds the children whose names contain a text.
+
+include(../Tests.pri)
+
+SOURCES += \
+    ../../Model/NameFilter.cpp \
+    tst_namefilter.cpp
+
+HEADERS += \
+    ../../Model/NameFilter.h
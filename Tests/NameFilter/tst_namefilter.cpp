@@ -0,0 +1,158 @@
+#include <QtTest>
+#include <QDir>
+
+#include "Model/NameFilter.h"
+#include "Shell/FileSystemItem.h"
+
+class TestNameFilter : public QObject
+{
+    Q_OBJECT
+
+private:
+    FileSystemItem *folder      {};
+
+    void addChildren(const QStringList &names);
+    static QList<int> accepted(NameFilter &filter, int count);
+
+private slots:
+    void init();
+    void cleanup();
+
+    void findsNamesIgnoringCase();
+    void neverMatchesAcrossNames();
+    void findsMatchesAnywhereInLongNames();
+    void followsGrowingAndShrinkingQueries();
+    void followsNewChildren();
+    void clears();
+};
+
+void TestNameFilter::addChildren(const QStringList &names)
+{
+    for (const QString &name : names) {
+#ifdef Q_OS_WIN
+        folder->addChild(new FileSystemItem(folder, name));
+#else
+        folder->addChild(new FileSystemItem(folder, name.toUtf8()));
+#endif
+    }
+}
+
+QList<int> TestNameFilter::accepted(NameFilter &filter, int count)
+{
+    QList<int> rows;
+    for (int row = 0; row < count; row++) {
+        if (filter.accepts(row))
+            rows.append(row);
+    }
+
+    return rows;
+}
+
+void TestNameFilter::init()
+{
+    folder = new FileSystemItem(QDir::toNativeSeparators(QDir::rootPath() + "folder"));
+}
+
+void TestNameFilter::cleanup()
+{
+    delete folder;
+    folder = nullptr;
+}
+
+void TestNameFilter::findsNamesIgnoringCase()
+{
+    addChildren({ "Report.txt", "notes.md", "OLD REPORTS", "image.png" });
+
+    NameFilter filter;
+    filter.setQuery(folder, "rEpOrT");
+
+    QVERIFY(filter.isActive());
+    QCOMPARE(accepted(filter, 4), QList<int>({ 0, 2 }));
+}
+
+void TestNameFilter::neverMatchesAcrossNames()
+{
+    addChildren({ "ab", "cd", "abcd" });
+
+    NameFilter filter;
+    filter.setQuery(folder, "bc");
+
+    QCOMPARE(accepted(filter, 3), QList<int>({ 2 }));
+}
+
+void TestNameFilter::findsMatchesAnywhereInLongNames()
+{
+    // The names are scanned eight characters at a time, so the matches fall on every position of a block, and the
+    // last one at the very end of the buffer
+    QStringList names;
+    for (int i = 0; i < 20; i++)
+        names.append(QString(i, 'a') + "needle" + QString(19 - i, 'b'));
+    names.append("nothing here");
+    names.append(QString(37, 'c') + "needle");
+    addChildren(names);
+
+    NameFilter filter;
+    filter.setQuery(folder, "needle");
+
+    QList<int> expected;
+    for (int row = 0; row < 20; row++)
+        expected.append(row);
+    expected.append(21);
+
+    QCOMPARE(accepted(filter, names.size()), expected);
+}
+
+void TestNameFilter::followsGrowingAndShrinkingQueries()
+{
+    addChildren({ "repo", "report", "reply", "prepare", "other" });
+
+    NameFilter filter;
+    filter.setQuery(folder, "rep");
+    QCOMPARE(accepted(filter, 5), QList<int>({ 0, 1, 2, 3 }));
+
+    // Only the rows that matched are looked at again
+    filter.setQuery(folder, "repo");
+    QCOMPARE(accepted(filter, 5), QList<int>({ 0, 1 }));
+
+    filter.setQuery(folder, "report");
+    QCOMPARE(accepted(filter, 5), QList<int>({ 1 }));
+
+    // And all of them when it shrinks
+    filter.setQuery(folder, "re");
+    QCOMPARE(accepted(filter, 5), QList<int>({ 0, 1, 2, 3 }));
+
+    filter.setQuery(folder, "o");
+    QCOMPARE(accepted(filter, 5), QList<int>({ 0, 1, 4 }));
+}
+
+void TestNameFilter::followsNewChildren()
+{
+    addChildren({ "first match", "no" });
+
+    NameFilter filter;
+    filter.setQuery(folder, "match");
+    QCOMPARE(accepted(filter, 2), QList<int>({ 0 }));
+
+    addChildren({ "second match" });
+    filter.invalidate();
+
+    QCOMPARE(accepted(filter, 3), QList<int>({ 0, 2 }));
+}
+
+void TestNameFilter::clears()
+{
+    addChildren({ "name" });
+
+    NameFilter filter;
+    QVERIFY(!filter.isActive());
+
+    filter.setQuery(folder, "name");
+    QVERIFY(filter.isActive());
+
+    filter.clear();
+    QVERIFY(!filter.isActive());
+}
+
+QTEST_GUILESS_MAIN(TestNameFilter)
+
+#include "tst_namefilter.moc"
@@ -0,0 +1,6 @@
+# Checks that the quick open palette finds the names with all the characters of a text, the best ones first.
+
+include(../Tests.pri)
+
+SOURCES += \
+    tst_nameindex.cpp
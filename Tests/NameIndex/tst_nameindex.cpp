@@ -0,0 +1,125 @@
+#include <QtTest>
+#include <QDir>
+
+#include "Shell/FileSystemItem.h"
+#include "Shell/NameIndex.h"
+
+class TestNameIndex : public QObject
+{
+    Q_OBJECT
+
+private:
+    FileSystemItem *folder      {};
+
+    void addChildren(const QStringList &names);
+    static QStringList search(const QString &query, int limit = 10);
+
+private slots:
+    void init();
+    void cleanup();
+
+    void findsNamesWithCharactersInOrder();
+    void ranksStartsAndWordsFirst();
+    void ranksConsecutiveCharactersFirst();
+    void ranksShorterNamesFirst();
+    void keepsBestMatches();
+    void followsRemovedChildren();
+    void ignoresEmptyQueries();
+};
+
+void TestNameIndex::addChildren(const QStringList &names)
+{
+    for (const QString &name : names) {
+#ifdef Q_OS_WIN
+        folder->addChild(new FileSystemItem(folder, name));
+#else
+        folder->addChild(new FileSystemItem(folder, name.toUtf8()));
+#endif
+    }
+}
+
+QStringList TestNameIndex::search(const QString &query, int limit)
+{
+    QStringList names;
+    for (const NameIndex::Match &match : NameIndex::search(query, limit))
+        names.append(match.item->getDisplayName());
+
+    return names;
+}
+
+void TestNameIndex::init()
+{
+    folder = new FileSystemItem(QDir::toNativeSeparators(QDir::rootPath() + "folder"));
+    folder->setIndexed(true);
+}
+
+void TestNameIndex::cleanup()
+{
+    // Its children are taken out of the index
+    delete folder;
+    folder = nullptr;
+}
+
+void TestNameIndex::findsNamesWithCharactersInOrder()
+{
+    addChildren({ "acb", "Xaybzc", "abc" });
+
+    QCOMPARE(search("ABC"), QStringList({ "abc", "Xaybzc" }));
+}
+
+void TestNameIndex::ranksStartsAndWordsFirst()
+{
+    addChildren({ "xreport.txt", "the report.txt", "report.txt" });
+
+    QCOMPARE(search("rep"), QStringList({ "report.txt", "the report.txt", "xreport.txt" }));
+}
+
+void TestNameIndex::ranksConsecutiveCharactersFirst()
+{
+    addChildren({ "xrxexpx", "xrepx" });
+
+    QCOMPARE(search("rep"), QStringList({ "xrepx", "xrxexpx" }));
+}
+
+void TestNameIndex::ranksShorterNamesFirst()
+{
+    addChildren({ "notes.markdown", "notes.txt", "notes.md" });
+
+    QCOMPARE(search("notes"), QStringList({ "notes.md", "notes.txt", "notes.markdown" }));
+}
+
+void TestNameIndex::keepsBestMatches()
+{
+    QStringList names;
+    for (int i = 0; i < 100; i++)
+        names.append(QString("x%1 data").arg(i));
+    names.append("data");
+    names.append("data.bin");
+    addChildren(names);
+
+    QCOMPARE(search("data", 2), QStringList({ "data", "data.bin" }));
+}
+
+void TestNameIndex::followsRemovedChildren()
+{
+    addChildren({ "alpha", "beta", "alphabet" });
+    QCOMPARE(search("alpha"), QStringList({ "alpha", "alphabet" }));
+
+    FileSystemItem *child = folder->getChildAt(0);
+    folder->removeChild(child->getPath());
+    delete child;
+
+    QCOMPARE(search("alpha"), QStringList({ "alphabet" }));
+}
+
+void TestNameIndex::ignoresEmptyQueries()
+{
+    addChildren({ "name" });
+
+    QVERIFY(search("").isEmpty());
+    QVERIFY(search("name", 0).isEmpty());
+}
+
+QTEST_GUILESS_MAIN(TestNameIndex)
+
+#include "tst_nameindex.moc"
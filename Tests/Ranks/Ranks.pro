@@ -0,0 +1,9 @@
+# Checks that the ranks kept by the sort models stay in order as rows are inserted and removed.
+
+include(../Tests.pri)
+
+HEADERS += \
+    ../../Model/Ranks.h
+
+SOURCES += \
+    tst_ranks.cpp
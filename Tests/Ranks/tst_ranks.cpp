@@ -0,0 +1,134 @@
+#include <QtTest>
+
+#include <algorithm>
+#include <numeric>
+
+#include "Model/Ranks.h"
+
+// Rows of the folder before the changes
+#define ROWS        1000
+
+class TestRanks : public QObject
+{
+    Q_OBJECT
+
+private:
+    static QVector<int> values(int count, int seed);
+    static QVector<int> rank(const QVector<int> &values);
+
+private slots:
+    void insertsInOrder_data();
+    void insertsInOrder();
+    void insertsAfterEqualRows();
+    void removesRows_data();
+    void removesRows();
+};
+
+/*!
+ * \brief Returns \a count different values in no particular order.
+ */
+QVector<int> TestRanks::values(int count, int seed)
+{
+    // 7919 is a prime, so multiplying by it shuffles the values as long as it doesn't divide the modulus
+    int modulus = 4 * (count + seed) + 1;
+    QVector<int> result(count);
+    for (int i = 0; i < count; i++)
+        result[i] = static_cast<int>((qint64(i + seed) * 7919) % modulus);
+
+    return result;
+}
+
+/*!
+ * \brief Ranks all the rows of \a values from scratch, like SortModel::rank() does.
+ */
+QVector<int> TestRanks::rank(const QVector<int> &values)
+{
+    QVector<int> rows(values.size());
+    std::iota(rows.begin(), rows.end(), 0);
+    std::stable_sort(rows.begin(), rows.end(), [&values](int left, int right) {
+        return values.at(left) < values.at(right);
+    });
+
+    QVector<int> ranks(values.size());
+    for (int position = 0; position < rows.size(); position++)
+        ranks[rows.at(position)] = position;
+
+    return ranks;
+}
+
+void TestRanks::insertsInOrder_data()
+{
+    QTest::addColumn<int>("first");
+    QTest::addColumn<int>("count");
+
+    QTest::newRow("one at the start") << 0 << 1;
+    QTest::newRow("one in the middle") << ROWS / 2 << 1;
+    QTest::newRow("one at the end") << ROWS << 1;
+    QTest::newRow("many at the start") << 0 << ROWS / 4;
+    QTest::newRow("many in the middle") << ROWS / 3 << ROWS / 4;
+    QTest::newRow("many at the end") << ROWS << ROWS;
+}
+
+void TestRanks::insertsInOrder()
+{
+    QFETCH(int, first);
+    QFETCH(int, count);
+
+    QVector<int> all = values(ROWS + count, 0);
+
+    // The values of the rows that were there before, without the new ones
+    QVector<int> before = all.mid(0, first) + all.mid(first + count);
+    QVector<int> ranks = rank(before);
+
+    Ranks::insert(ranks, first, count, [&all](int left, int right) {
+        return all.at(left) < all.at(right);
+    });
+
+    QCOMPARE(ranks, rank(all));
+}
+
+void TestRanks::insertsAfterEqualRows()
+{
+    QVector<int> before { 3, 1, 2, 1, 3 };
+    QVector<int> ranks = rank(before);
+
+    // Two new rows at the start, equal to rows already there
+    QVector<int> all { 1, 3, 3, 1, 2, 1, 3 };
+    Ranks::insert(ranks, 0, 2, [&all](int left, int right) {
+        return all.at(left) < all.at(right);
+    });
+
+    // The rows already there keep their places among the equal ones
+    QVector<int> expected { 2, 6, 4, 0, 3, 1, 5 };
+    QCOMPARE(ranks, expected);
+}
+
+void TestRanks::removesRows_data()
+{
+    QTest::addColumn<int>("first");
+    QTest::addColumn<int>("last");
+
+    QTest::newRow("one at the start") << 0 << 0;
+    QTest::newRow("one in the middle") << ROWS / 2 << ROWS / 2;
+    QTest::newRow("one at the end") << ROWS - 1 << ROWS - 1;
+    QTest::newRow("many in the middle") << ROWS / 3 << ROWS / 2;
+    QTest::newRow("all of them") << 0 << ROWS - 1;
+}
+
+void TestRanks::removesRows()
+{
+    QFETCH(int, first);
+    QFETCH(int, last);
+
+    QVector<int> all = values(ROWS, 1);
+    QVector<int> ranks = rank(all);
+
+    Ranks::remove(ranks, first, last);
+
+    QVector<int> after = all.mid(0, first) + all.mid(last + 1);
+    QCOMPARE(ranks, rank(after));
+}
+
+QTEST_GUILESS_MAIN(TestRanks)
+
+#include "tst_ranks.moc"
@@ -0,0 +1,35 @@
+# Settings shared by all the unit tests.  Every test is a console program built from the sources it tests, along with
+# the items and the collation they all need.
+
+QT       += core gui concurrent testlib
+
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+
+CONFIG += c++17 console testcase
+CONFIG -= app_bundle
+DEFINES += ICU_COLLATOR
+
+INCLUDEPATH += $$PWD/..
+
+SOURCES += \
+    $$PWD/../Shell/Collation.cpp \
+    $$PWD/../Shell/FileSystemItem.cpp \
+    $$PWD/../Shell/FileSystemItemArena.cpp \
+    $$PWD/../Shell/FileTypeCache.cpp \
+    $$PWD/../Shell/NameIndex.cpp
+
+HEADERS += \
+    $$PWD/../Shell/Collation.h \
+    $$PWD/../Shell/FileSystemItem.h \
+    $$PWD/../Shell/FileSystemItemArena.h \
+    $$PWD/../Shell/FileTypeCache.h \
+    $$PWD/../Shell/NameIndex.h
+
+unix {
+    LIBS += -licui18n -licuuc
+}
+
+win32 {
+    INCLUDEPATH += $$PWD/../ThirdParty/Win/icu4c-68/include
+    LIBS += -L$$PWD/../ThirdParty/Win/icu4c-68/bin -licuin68 -licuuc68
+}
@@ -0,0 +1,10 @@
+# Unit tests of the parts of the application that don't need the file system or a window.
+# Run them with "make check".
+
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    ChildrenIndex \
+    NameFilter \
+    NameIndex \
+    Ranks
@@ -15,6 +15,9 @@
 #include "Model/FileSystemModel.h"
 #include "Model/TreeModel.h"
 
+// Time the user has to stay on an item before the folders around it are prefetched
+#define PREFETCH_DELAY_MSECS    300
+
 /*!
  * \brief The constructor.
  * \param parent The QWidget parent.
@@ -40,6 +43,12 @@ BaseTreeView::BaseTreeView(QWidget *parent) : QTreeView(parent)
     QTimer *timer = new QTimer(this);
     connect(timer, &QTimer::timeout, this, &BaseTreeView::processQueuedSignals);
     timer->start(10);
+
+    // Fast browsing restarts this timer, so it doesn't start a fetch for every item the user goes through
+    prefetchTimer = new QTimer(this);
+    prefetchTimer->setSingleShot(true);
+    prefetchTimer->setInterval(PREFETCH_DELAY_MSECS);
+    connect(prefetchTimer, &QTimer::timeout, this, &BaseTreeView::prefetch);
 }
 
 BaseTreeView::~BaseTreeView()
@@ -305,6 +314,31 @@ void BaseTreeView::shouldEdit(QModelIndex index)
     QAbstractItemView::edit(index);
 }
 
+/*!
+ * \brief Asks the model to fetch the folders \a indexes ahead of time, after a short delay.
+ * \param indexes a list of indexes of this view.
+ *
+ * A new call before the delay expires replaces the previous list.
+ */
+void BaseTreeView::schedulePrefetch(const QModelIndexList &indexes)
+{
+    prefetchIndexes.clear();
+    for (const QModelIndex &index : indexes)
+        prefetchIndexes.append(QPersistentModelIndex(index));
+
+    prefetchTimer->start();
+}
+
+void BaseTreeView::prefetch()
+{
+    for (const QPersistentModelIndex &index : qAsConst(prefetchIndexes)) {
+        if (index.isValid())
+            model()->setData(index, QVariant(), FileSystemModel::PrefetchRole);
+    }
+
+    prefetchIndexes.clear();
+}
+
 void BaseTreeView::updateRefCounter(QModelIndex index, bool increase)
 {
     QModelIndex i = index;
@@ -640,7 +674,7 @@ void BaseTreeView::contextMenuRequested(const QPoint &pos)
     QModelIndexList sourceIndexList;
     ContextMenu::ContextViewAspect viewAspect;
 
-    QSortFilterProxyModel *proxyModel = reinterpret_cast<QSortFilterProxyModel *>(model());
+    SortModel *sortModel = reinterpret_cast<SortModel *>(model());
 
     // Get current selected item if any
     QModelIndex index = indexAt(pos);
@@ -658,13 +692,13 @@ void BaseTreeView::contextMenuRequested(const QPoint &pos)
         QModelIndexList list = selectedIndexes();
         for (const QModelIndex &selectedIndex : list) {
             if (selectedIndex.column() == 0) {
-                sourceIndexList.append(proxyModel->mapToSource(selectedIndex));
+                sourceIndexList.append(sortModel->mapToFileSystemModel(selectedIndex));
                 qDebug() << "BaseTreeView::contextMenuRequested for item" << selectedIndex.data(FileSystemModel::PathRole).toString();
             }
         }
     } else {
         viewAspect = ContextMenu::Background;
-        sourceIndexList.append(proxyModel->mapToSource(rootIndex()));
+        sourceIndexList.append(sortModel->mapToFileSystemModel(rootIndex()));
         qDebug() << "BaseTreeView::contextMenuRequested selected for the background on " << rootIndex().data(FileSystemModel::PathRole).toString();
     }
 
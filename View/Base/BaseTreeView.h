@@ -32,6 +32,7 @@
 
 #include <QTreeView>
 #include <QMutex>
+#include <QTimer>
 
 #include "Shell/ContextMenu.h"
 #include "Shell/FileSystemItem.h"
@@ -112,6 +113,8 @@ protected:
     virtual void backEvent();
     virtual void forwardEvent();
 
+    void schedulePrefetch(const QModelIndexList &indexes);
+
 private:
 
     QMutex mutex;
@@ -131,12 +134,17 @@ private:
 
     QModelIndex editIndex   {};
 
+    // Folders to fetch ahead of time when the prefetch timer expires
+    QTimer *prefetchTimer                       {};
+    QList<QPersistentModelIndex> prefetchIndexes;
+
 private slots:
     void setNormalCursor();
     void setBusyCursor();
     void processQueuedSignals();
     void editorClosed();
     void updateRefCounter(QModelIndex index, bool increase);
+    void prefetch();
 };
 
 #endif // BASETREEVIEW_H
@@ -42,11 +42,11 @@ CustomExplorer::CustomExplorer(int nExplorer, QWidget *parent) : QFrame(parent)
 {
     setupGui(nExplorer);
 
-    FileSystemModel *fileSystemModel = new FileSystemModel(this);
-    fileSystemModel->setDefaultRoot();
+    // The model is shared with the other explorers, this one only has its own proxies and views
+    FileSystemModel *fileSystemModel = AppWindow::instance()->getFileSystemModel();
 
     treeModel = new TreeModel(this);
-    treeModel->setSourceModel(fileSystemModel);
+    treeModel->setSourceModel(AppWindow::instance()->getFolderModel());
     treeModel->setObjectName("FilterModel");
 
     model = fileSystemModel;
@@ -92,7 +92,7 @@ void CustomExplorer::initialize()
 
     // Errors
     connect(treeModel, &QAbstractItemModel::dataChanged, [=](const QModelIndex &topLeft, const QModelIndex &, const QVector<int> &roles) {
-        if (roles.contains(FileSystemModel::ErrorCodeRole))
+        if (roles.contains(FileSystemModel::ErrorCodeRole) && isShowing(topLeft))
             showError(topLeft);
     });
 
@@ -108,7 +108,7 @@ void CustomExplorer::initialize()
         viewIndexChanged(sourceIndex);
 
         if (!sourceIndex.parent().isValid())
-            treeView->expand(treeModel->mapFromSource(sourceIndex));
+            treeView->expand(treeModel->mapFromFileSystemModel(sourceIndex));
     } else {
         expandAndSelectAbsolute(view->getPath());
     }
@@ -160,7 +160,7 @@ void CustomExplorer::expandAndSelectAbsolute(QString path)
         });
 
         // This will trigger the background fetching
-        treeView->expand(treeModel->mapFromSource(parentIndex));
+        treeView->expand(treeModel->mapFromFileSystemModel(parentIndex));
         return;
     }
 
@@ -168,7 +168,7 @@ void CustomExplorer::expandAndSelectAbsolute(QString path)
     if (path == parentIndex.data(FileSystemModel::PathRole).toString()) {
 
         tabWidget->setViewRootIndex(parentIndex);
-        QModelIndex parentTree = treeModel->mapFromSource(parentIndex);
+        QModelIndex parentTree = treeModel->mapFromFileSystemModel(parentIndex);
 
         // Always expand root
         treeView->expand(parentTree);
@@ -206,12 +206,12 @@ void CustomExplorer::expandAndSelectAbsolute(QString path)
                 });
 
                 // This will trigger the background fetching
-                treeView->expand(treeModel->mapFromSource(parentIndex));
+                treeView->expand(treeModel->mapFromFileSystemModel(parentIndex));
                 return;
 
             } else {
-                if (!treeView->isExpanded(parentIndex)) {
-                    treeView->expand(treeModel->mapFromSource(parentIndex));
+                if (!treeView->isExpanded(treeModel->mapFromFileSystemModel(parentIndex))) {
+                    treeView->expand(treeModel->mapFromFileSystemModel(parentIndex));
                 }
 
                 // Parent has all children fetched and expanded at this point
@@ -304,7 +304,7 @@ void CustomExplorer::tabChanged(int index)
         QSortFilterProxyModel *viewModel = static_cast<QSortFilterProxyModel *>(detailedView->model());
         QModelIndex sourceIndex = viewModel->mapToSource(detailedView->rootIndex());
 
-        QModelIndex treeIndex = treeModel->mapFromSource(sourceIndex);
+        QModelIndex treeIndex = treeModel->mapFromFileSystemModel(sourceIndex);
         treeView->setCurrentIndex(treeIndex);
         treeView->scrollTo(treeIndex);
 
@@ -331,6 +331,20 @@ void CustomExplorer::showError(const QModelIndex &index)
     }
 }
 
+/*!
+ * \brief Returns true if the folder \a index of the tree model is selected or expanded in this explorer.
+ *
+ * The model is shared with the other explorers, so this tells apart the errors of the folders this explorer asked for.
+ */
+bool CustomExplorer::isShowing(const QModelIndex &index) const
+{
+    if (treeView->selectedItem() == index || treeView->isExpanded(index))
+        return true;
+
+    QAbstractItemView *view = static_cast<QAbstractItemView *>(tabWidget->currentWidget());
+    return view != nullptr && view->rootIndex().data(FileSystemModel::PathRole) == index.data(FileSystemModel::PathRole);
+}
+
 CustomTabWidget *CustomExplorer::getTabWidget() const
 {
     return tabWidget;
@@ -338,7 +352,7 @@ CustomTabWidget *CustomExplorer::getTabWidget() const
 
 bool CustomExplorer::setViewRootIndex(const QModelIndex &index)
 {
-    const QModelIndex& source = treeModel->mapToSource(index);
+    const QModelIndex& source = treeModel->mapToFileSystemModel(index);
     return tabWidget->setViewRootIndex(source);
 }
 
@@ -420,7 +434,7 @@ void CustomExplorer::setupGui(int nExplorer)
 void CustomExplorer::viewIndexChanged(const QModelIndex &sourceIndex)
 {
     qDebug() << "CustomExplorer::viewIndexChanged";
-    const QModelIndex &treeIndex = treeModel->mapFromSource(sourceIndex);
+    const QModelIndex &treeIndex = treeModel->mapFromFileSystemModel(sourceIndex);
     treeView->setCurrentIndex(treeIndex);
 
     DetailedView *detailedView = static_cast<DetailedView *>(tabWidget->currentWidget());
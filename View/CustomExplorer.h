@@ -79,6 +79,7 @@ private:
     TreeModel *treeModel;
 
     void setupGui(int nExplorer);
+    bool isShowing(const QModelIndex &index) const;
 
 private slots:
     void viewIndexChanged(const QModelIndex &sourceIndex);
@@ -239,12 +239,32 @@ bool CustomTabWidget::setViewRootIndex(const QModelIndex &sourceIndex)
     return false;
 }
 
+/*!
+ * \brief Makes \a sourceIndex the current item of the current tab, if the tab shows the folder of \a sourceIndex.
+ * \param sourceIndex an index of the FileSystemModel.
+ */
+void CustomTabWidget::selectIndex(const QModelIndex &sourceIndex)
+{
+    DetailedView *detailedView = static_cast<DetailedView *>(currentWidget());
+    SortModel *sortModel = reinterpret_cast<SortModel *>(detailedView->model());
+
+    if (sortModel == nullptr || !sourceIndex.isValid())
+        return;
+
+    QModelIndex proxyIndex = sortModel->mapFromSource(sourceIndex);
+    if (proxyIndex.isValid() && proxyIndex.parent() == detailedView->rootIndex()) {
+        detailedView->setCurrentIndex(proxyIndex);
+        detailedView->scrollTo(proxyIndex);
+        detailedView->setFocus();
+    }
+}
+
 void CustomTabWidget::viewIndexSelected(const QModelIndex &index)
 {
     qDebug() << "CustomTabWidget::viewIndexSelected";
     if (index.isValid()) {
         const SortModel *model = reinterpret_cast<const SortModel *>(index.model());
-        QModelIndex sourceIndex = model->mapToSource(index);
+        QModelIndex sourceIndex = model->mapToFileSystemModel(index);
         if (!sourceIndex.data(FileSystemModel::FileRole).toBool()) {
             if (setViewRootIndex(sourceIndex)) {
             //    emit viewIndexChanged(sourceIndex);
@@ -17,6 +17,7 @@ public:
     void copyCurrentTab();
     void setUpTab(int tab, const QModelIndex& sourceIndex);
     void saveSettings(int pane);
+    void selectIndex(const QModelIndex &sourceIndex);
 
 public slots:
     bool setViewRootIndex(const QModelIndex &index);
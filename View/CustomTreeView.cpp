@@ -11,6 +11,9 @@
 #include "Model/SortModel.h"
 #include "Base/BaseItemDelegate.h"
 
+// Number of folders above and below the current one that are prefetched
+#define PREFETCH_SIBLINGS       2
+
 #include <QProxyStyle>
 
 /*!
@@ -307,3 +310,44 @@ bool CustomTreeView::viewportEvent(QEvent *event)
 
     return QTreeView::viewportEvent(event);
 }
+
+/*!
+ * \brief Draws the row at \a index.
+ *
+ * Before the row is painted the model is asked to find out if the folder really has subfolders, so only the folders
+ * that are visible are ever probed.
+ */
+void CustomTreeView::drawRow(QPainter *painter, const QStyleOptionViewItem &options, const QModelIndex &index) const
+{
+    model()->setData(index, QVariant(), FileSystemModel::ProbeSubFoldersRole);
+
+    BaseTreeView::drawRow(painter, options, index);
+}
+
+void CustomTreeView::dataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight, const QVector<int> &roles)
+{
+    BaseTreeView::dataChanged(topLeft, bottomRight, roles);
+
+    // The expand indicator of the items is only updated when the items are laid out again
+    if (roles.contains(FileSystemModel::HasSubFoldersRole))
+        scheduleDelayedItemsLayout();
+}
+
+/*!
+ * \brief Prefetches the folders next to \a current, since the user is likely to go through them next.
+ */
+void CustomTreeView::currentChanged(const QModelIndex &current, const QModelIndex &previous)
+{
+    BaseTreeView::currentChanged(current, previous);
+
+    if (!current.isValid())
+        return;
+
+    QModelIndexList siblings;
+    for (int offset = 1; offset <= PREFETCH_SIBLINGS; offset++) {
+        siblings.append(current.sibling(current.row() + offset, 0));
+        siblings.append(current.sibling(current.row() - offset, 0));
+    }
+
+    schedulePrefetch(siblings);
+}
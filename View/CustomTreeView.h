@@ -12,6 +12,8 @@ public:
 
     QModelIndex selectedItem();
 
+    void dataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight, const QVector<int> &roles = QVector<int>()) override;
+
 public slots:
     void shouldEdit(QModelIndex sourceIndex) override;
 
@@ -27,6 +29,8 @@ protected:
     bool viewportEvent(QEvent *event) override;
     void selectEvent() override;
     void keyPressEvent(QKeyEvent *event) override;
+    void drawRow(QPainter *painter, const QStyleOptionViewItem &options, const QModelIndex &index) const override;
+    void currentChanged(const QModelIndex &current, const QModelIndex &previous) override;
 
 private:
     QModelIndex hoverIndex;
@@ -1,12 +1,18 @@
 #include <QSortFilterProxyModel>
 #include <QHeaderView>
 #include <QMouseEvent>
+#include <QLineEdit>
 #include <QDebug>
 #include <QScrollBar>
 
 #include "DetailedView.h"
 #include "DateItemDelegate.h"
 
+#include "Model/SortModel.h"
+
+// Maximum width of the filter box, in pixels
+#define FILTER_WIDTH            250
+
 DetailedView::DetailedView(QWidget *parent) : BaseTreeView(parent)
 {
     setRootIsDecorated(false);
@@ -30,6 +36,19 @@ DetailedView::DetailedView(QWidget *parent) : BaseTreeView(parent)
 
     this->header()->setMinimumSectionSize(100);
     this->header()->setStretchLastSection(false);
+
+    // The filter box floats over the bottom right corner of the view while it's being used
+    filterEdit = new QLineEdit(this);
+    filterEdit->setPlaceholderText(tr("Filter"));
+    filterEdit->setClearButtonEnabled(true);
+    filterEdit->hide();
+
+    connect(filterEdit, &QLineEdit::textChanged, this, [this](const QString &text) {
+        SortModel *sortModel = reinterpret_cast<SortModel *>(model());
+        if (sortModel != nullptr)
+            sortModel->setNameFilter(rootIndex(), text);
+    });
+    connect(filterEdit, &QLineEdit::returnPressed, this, [this]() { setFocus(); });
 }
 
 void DetailedView::setModel(QAbstractItemModel *model)
@@ -58,6 +77,10 @@ void DetailedView::setRootIndex(const QModelIndex &index)
 {
     qDebug() << "DetailedView::setRootIndex";
 
+    // The filter only applies to the folder it was typed in
+    if (filterEdit->isVisible())
+        hideFilter();
+
     BaseTreeView::setRootIndex(index);
 
     if (index.isValid())
@@ -203,6 +226,89 @@ void DetailedView::mouseReleaseEvent(QMouseEvent *event)
 
 }
 
+/*!
+ * \brief Prefetches the folder under the mouse cursor, since the user is likely to open it next.
+ */
+bool DetailedView::viewportEvent(QEvent *event)
+{
+    if (event->type() == QEvent::HoverMove) {
+
+        QHoverEvent *hoverEvent = static_cast<QHoverEvent *>(event);
+        QModelIndex index = indexAt(hoverEvent->pos());
+
+        if (index.isValid())
+            index = index.sibling(index.row(), 0);
+
+        if (index != hoverIndex) {
+            hoverIndex = index;
+
+            QModelIndexList indexes;
+            if (index.isValid() && index.data(FileSystemModel::FolderRole).toBool())
+                indexes.append(index);
+
+            schedulePrefetch(indexes);
+        }
+    }
+
+    return BaseTreeView::viewportEvent(event);
+}
+
+/*!
+ * \brief Shows the filter box with Ctrl+F, and hides it with Escape.
+ *
+ * The filter box doesn't handle these keys, so they get here from it too.
+ */
+void DetailedView::keyPressEvent(QKeyEvent *event)
+{
+    if (event->matches(QKeySequence::Find)) {
+        showFilter();
+        event->accept();
+    } else if (event->key() == Qt::Key_Escape && filterEdit->isVisible()) {
+        hideFilter();
+        event->accept();
+    } else
+        BaseTreeView::keyPressEvent(event);
+}
+
+void DetailedView::resizeEvent(QResizeEvent *event)
+{
+    BaseTreeView::resizeEvent(event);
+
+    if (filterEdit->isVisible())
+        placeFilter();
+}
+
+void DetailedView::showFilter()
+{
+    placeFilter();
+    filterEdit->show();
+    filterEdit->setFocus();
+    filterEdit->selectAll();
+}
+
+/*!
+ * \brief Hides the filter box and shows all the items again.
+ */
+void DetailedView::hideFilter()
+{
+    bool hadFocus = filterEdit->hasFocus();
+
+    filterEdit->clear();
+    filterEdit->hide();
+
+    if (hadFocus)
+        setFocus();
+}
+
+void DetailedView::placeFilter()
+{
+    QRect area = viewport()->geometry();
+    int width = qMin(FILTER_WIDTH, area.width());
+    int height = filterEdit->sizeHint().height();
+
+    filterEdit->setGeometry(area.right() - width + 1, area.bottom() - height + 1, width, height);
+}
+
 void DetailedView::backEvent()
 {
     if (history->canGoBack()) {
@@ -6,6 +6,8 @@
 #include "Shell/ContextMenu.h"
 #include "Base/BaseTreeView.h"
 
+class QLineEdit;
+
 class DetailedView : public BaseTreeView
 {
     Q_OBJECT
@@ -25,12 +27,15 @@ signals:
 
 protected:
     void selectEvent() override;
+    void keyPressEvent(QKeyEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
     void mouseDoubleClickEvent(QMouseEvent *event) override;
     void mousePressEvent(QMouseEvent *event) override;
     void mouseMoveEvent(QMouseEvent *event) override;
     void mouseReleaseEvent(QMouseEvent *event) override;
     void backEvent() override;
     void forwardEvent() override;
+    bool viewportEvent(QEvent *event) override;
 
     void setSelection(const QRect &rect, QItemSelectionModel::SelectionFlags command) override;
     void setSelectionFromViewportRect(const QRect &rect, QItemSelection &currentSelection, QItemSelectionModel::SelectionFlags command);
@@ -41,6 +46,12 @@ private:
     QItemSelection currentSelection                 {};
     QItemSelectionModel::SelectionFlags command     {};
     FileSystemHistory *history                      {};
+    QPersistentModelIndex hoverIndex                {};
+    QLineEdit *filterEdit                           {};
+
+    void showFilter();
+    void hideFilter();
+    void placeFilter();
 
 };
 
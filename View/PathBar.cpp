@@ -1,10 +1,11 @@
-#include <QSortFilterProxyModel>
 #include <QHBoxLayout>
 #include <QDebug>
 #include <QMenu>
 
 #include "PathBar.h"
 
+#include "Model/SortModel.h"
+
 #define BASESTYLESHEET      "QFrame { background: white; border-bottom: 1px solid #9fcdb3; } " \
                             "QPushButton { border-style: none; background-color: transparent; } "
 #define BUTTONSTYLESHEET    "QPushButton:hover { background-color: #500fbd46; } QPushButton:pressed { background-color: #800fbd46; }"
@@ -112,9 +113,9 @@ void PathBar::selectedIndex(const QModelIndex &index)
 {
     if (index.isValid()) {
 
-        const QSortFilterProxyModel *treeModel = reinterpret_cast<const QSortFilterProxyModel *>(index.model());
+        const SortModel *treeModel = reinterpret_cast<const SortModel *>(index.model());
 
-        emit rootIndexChangeRequested(treeModel->mapToSource(index));
+        emit rootIndexChangeRequested(treeModel->mapToFileSystemModel(index));
     }
 }
 
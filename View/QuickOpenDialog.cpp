@@ -0,0 +1,103 @@
+#include <QListWidgetItem>
+#include <QApplication>
+#include <QListWidget>
+#include <QVBoxLayout>
+#include <QKeyEvent>
+#include <QLineEdit>
+#include <QDebug>
+
+#include "QuickOpenDialog.h"
+
+#include "Shell/FileSystemItem.h"
+#include "Shell/NameIndex.h"
+
+// Number of matches listed
+#define QUICK_OPEN_RESULTS      50
+
+// Roles of the items of the list
+#define QUICK_OPEN_PATH_ROLE    (Qt::UserRole)
+#define QUICK_OPEN_FOLDER_ROLE  (Qt::UserRole + 1)
+#define QUICK_OPEN_PARENT_ROLE  (Qt::UserRole + 2)
+
+QuickOpenDialog::QuickOpenDialog(QWidget *parent) : QDialog(parent)
+{
+    setWindowTitle(tr("Go to File"));
+    resize(600, 400);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+
+    queryEdit = new QLineEdit(this);
+    queryEdit->setPlaceholderText(tr("Type part of a name"));
+    layout->addWidget(queryEdit);
+
+    resultList = new QListWidget(this);
+    resultList->setUniformItemSizes(true);
+    layout->addWidget(resultList);
+
+    connect(queryEdit, &QLineEdit::textChanged, this, &QuickOpenDialog::search);
+    connect(queryEdit, &QLineEdit::returnPressed, this, [this]() {
+        if (resultList->currentItem() != nullptr)
+            accept();
+    });
+    connect(resultList, &QListWidget::itemActivated, this, &QuickOpenDialog::accept);
+}
+
+QString QuickOpenDialog::getSelectedPath() const
+{
+    QListWidgetItem *item = resultList->currentItem();
+    return (item != nullptr) ? item->data(QUICK_OPEN_PATH_ROLE).toString() : QString();
+}
+
+/*!
+ * \brief Returns the path of the folder of the selected item.
+ */
+QString QuickOpenDialog::getSelectedFolderPath() const
+{
+    QListWidgetItem *item = resultList->currentItem();
+    return (item != nullptr) ? item->data(QUICK_OPEN_PARENT_ROLE).toString() : QString();
+}
+
+bool QuickOpenDialog::isSelectedFolder() const
+{
+    QListWidgetItem *item = resultList->currentItem();
+    return item != nullptr && item->data(QUICK_OPEN_FOLDER_ROLE).toBool();
+}
+
+/*!
+ * \brief Moves through the matches with the arrows while the focus stays in the query.
+ */
+void QuickOpenDialog::keyPressEvent(QKeyEvent *event)
+{
+    switch (event->key()) {
+        case Qt::Key_Up:
+        case Qt::Key_Down:
+        case Qt::Key_PageUp:
+        case Qt::Key_PageDown:
+            QApplication::sendEvent(resultList, event);
+            break;
+
+        default:
+            QDialog::keyPressEvent(event);
+    }
+}
+
+void QuickOpenDialog::search(const QString &query)
+{
+    resultList->clear();
+
+    // The items are only valid until the event loop runs again, so everything needed is copied now
+    for (const NameIndex::Match &match : NameIndex::search(query, QUICK_OPEN_RESULTS)) {
+
+        FileSystemItem *item = match.item;
+        FileSystemItem *parent = item->getParent();
+        QString parentPath = (parent != nullptr) ? parent->getPath() : QString();
+
+        QListWidgetItem *listItem = new QListWidgetItem(item->getIcon(), item->getDisplayName() + "    " + parentPath);
+        listItem->setData(QUICK_OPEN_PATH_ROLE, item->getPath());
+        listItem->setData(QUICK_OPEN_FOLDER_ROLE, item->isFolder() || item->isDrive());
+        listItem->setData(QUICK_OPEN_PARENT_ROLE, parentPath);
+        resultList->addItem(listItem);
+    }
+
+    resultList->setCurrentRow(0);
+}
@@ -0,0 +1,35 @@
+#ifndef QUICKOPENDIALOG_H
+#define QUICKOPENDIALOG_H
+
+#include <QDialog>
+
+class QLineEdit;
+class QListWidget;
+
+/*!
+ * \brief A palette to jump to any file or folder already loaded, by typing some characters of its name.
+ *
+ * The names are looked up in the NameIndex as the user types, and the best matches are listed first.
+ */
+class QuickOpenDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    QuickOpenDialog(QWidget *parent = nullptr);
+
+    QString getSelectedPath() const;
+    QString getSelectedFolderPath() const;
+    bool isSelectedFolder() const;
+
+protected:
+    void keyPressEvent(QKeyEvent *event) override;
+
+private:
+    QLineEdit *queryEdit        {};
+    QListWidget *resultList     {};
+
+    void search(const QString &query);
+};
+
+#endif // QUICKOPENDIALOG_H
@@ -29,6 +29,7 @@
 
 #include <QApplication>
 #include <QHeaderView>
+#include <QAction>
 #include <QJsonArray>
 #include <QResizeEvent>
 #include <QDebug>
@@ -39,6 +40,9 @@
 #include "AppWindow.h"
 
 #include "View/CustomExplorer.h"
+#include "View/QuickOpenDialog.h"
+#include "Model/FileSystemModel.h"
+#include "Model/FolderModel.h"
 
 #define APPLICATION_TITLE   "Yappari Explorer"
 
@@ -94,6 +98,11 @@ AppWindow::AppWindow(QWidget *parent) : MAINWINDOW(parent)
  */
 AppWindow::~AppWindow()
 {
+    // The views release the folders they show when they are destroyed, so they must go before the model
+    qDeleteAll(explorers);
+    explorers.clear();
+    delete fileSystemModel;
+
     qDebug() << "AppWindow::~AppWindow Destroyed";
 }
 
@@ -275,6 +284,27 @@ WId AppWindow::getWindowId() const
     return windowId;
 }
 
+/*!
+ * \brief Returns the model shared by all the explorers of this window.
+ * \return a FileSystemModel pointer.
+ *
+ * Every explorer has its own views and proxy models on top of this model, so a folder shown in several panes or tabs
+ * is read, watched and kept in memory only once.
+ */
+FileSystemModel *AppWindow::getFileSystemModel() const
+{
+    return fileSystemModel;
+}
+
+/*!
+ * \brief Returns the folders of the shared model, the source of the trees of all the explorers.
+ * \return a FolderModel pointer.
+ */
+FolderModel *AppWindow::getFolderModel() const
+{
+    return folderModel;
+}
+
 /*!
  * \brief Sets up the GUI.
  *
@@ -319,6 +349,14 @@ void AppWindow::setupGui()
     } else
         w = contentWidget();
 
+    // All the explorers share the same model
+    fileSystemModel = new FileSystemModel(this);
+
+    // And the trees of all of them only see its folders
+    folderModel = new FolderModel(this);
+    folderModel->setSourceModel(fileSystemModel);
+    fileSystemModel->setDefaultRoot();
+
     // Create explorers
     CustomExplorer *cExplorer {};
     for (int i = 0; i < nExplorers; i++) {
@@ -402,6 +440,13 @@ void AppWindow::setupGui()
         showMaximized();
     }
 
+    // Jump to any item already loaded
+    QAction *quickOpenAction = new QAction(this);
+    quickOpenAction->setShortcut(QKeySequence(Qt::CTRL + Qt::Key_P));
+    quickOpenAction->setShortcutContext(Qt::WindowShortcut);
+    connect(quickOpenAction, &QAction::triggered, this, &AppWindow::quickOpen);
+    addAction(quickOpenAction);
+
 
     qDebug() << "AppWindow::setupGui windows geometry restored";
 }
@@ -455,6 +500,36 @@ void AppWindow::saveSettings()
     delete Settings::settings;
 }
 
+/*!
+ * \brief Shows the quick open palette, and goes to the item selected in the explorer that has the focus.
+ *
+ * Folders are selected in the tree.  Files are selected in the current tab, once it shows their folder.
+ */
+void AppWindow::quickOpen()
+{
+    CustomExplorer *explorer = explorers.isEmpty() ? nullptr : explorers.first();
+    for (CustomExplorer *cExplorer : explorers) {
+        if (cExplorer->isAncestorOf(QApplication::focusWidget()))
+            explorer = cExplorer;
+    }
+
+    if (explorer == nullptr)
+        return;
+
+    QuickOpenDialog dialog(this);
+    if (dialog.exec() != QDialog::Accepted || dialog.getSelectedPath().isEmpty())
+        return;
+
+    qDebug() << "AppWindow::quickOpen" << dialog.getSelectedPath();
+
+    if (dialog.isSelectedFolder())
+        explorer->expandAndSelectAbsolute(dialog.getSelectedPath());
+    else {
+        explorer->expandAndSelectAbsolute(dialog.getSelectedFolderPath());
+        explorer->getTabWidget()->selectIndex(fileSystemModel->index(dialog.getSelectedPath()));
+    }
+}
+
 /*!
  * \brief Resizes the splitter of the other CustomExplorer
  *
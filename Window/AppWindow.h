@@ -52,6 +52,8 @@
 
 // We can't include CustomExplorer.h here so we just declare it
 class CustomExplorer;
+class FileSystemModel;
+class FolderModel;
 
 /*!
  * \brief AppWindow class.
@@ -74,6 +76,8 @@ public:
     static AppWindow *instance();
 
     WId getWindowId() const;
+    FileSystemModel *getFileSystemModel() const;
+    FolderModel *getFolderModel() const;
 
 signals:
 
@@ -95,6 +99,10 @@ private:
     QList<CustomExplorer *> explorers;
     QList<QSplitter *>      splitters;
 
+    // Shared by all the explorers
+    FileSystemModel *fileSystemModel {};
+    FolderModel *folderModel         {};
+
     ContextMenu *contextMenu {};
     quint32 nextId {};
     QMutex regMutex;
@@ -108,6 +116,7 @@ private:
 
 private slots:
     void resizeOtherSplitter(QSplitter *splitter);
+    void quickOpen();
 
 };
 